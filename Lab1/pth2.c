@@ -1,14 +1,20 @@
-
-// gcc pth2.c -o pth2 -lpthread -lm
+// gcc -O3 -march=native -fno-math-errno -fno-trapping-math pth2.c -o pth2 -lpthread -lm
+// the two -fno flags let GCC vectorize sqrt and the selects in the vector
+// engine; without -march=native it only gets SSE2
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
 #include <pthread.h>
 #include <math.h>
+#include <unistd.h>
 #include <sys/time.h>
 
 int *arr;
 int *arr2;
+int *arr3;
 int arr_len = 50000000;
 int nthreads = 4;
 
@@ -31,48 +37,743 @@ int nthreads = 4;
                                    (int)log2((double)(x)) + \
                                    (int)sqrt((double)(x))
 
+/* [start, end) of thread id; the first arr_len % nthreads threads get
+ * one element more, so the tail is never dropped */
+void partition(int id, int *start, int *end) {
+    *start = (int)(((long)arr_len * id) / nthreads);
+    *end = (int)(((long)arr_len * (id + 1)) / nthreads);
+}
+
 void * add_to_arr(void *n) {
-    int id = *(int *) n;
-    int start = (arr_len * id) / nthreads;
-    int end = start + arr_len / nthreads;
+    int start, end;
+    partition(*(int *) n, &start, &end);
     for (int i = start; i < end; i++) {
         arr2[i] = DO_COMPLEX_CALCULATIONS(arr[i]);
     }
+    return NULL;
 }
 
-int main (int argc, char ** argv) {
-    arr = calloc(arr_len * sizeof(int), 1);
-    arr2 = calloc(arr_len * sizeof(int), 1);
-    int ids[nthreads];
-    struct timeval start, finish;
-    
-    printf("Starting Computation\n"); 
-    gettimeofday(&start, NULL);
-    for (int i = 0; i < arr_len; i++) {
-        arr2[i] = DO_COMPLEX_CALCULATIONS(arr[i]);
+/*
+ * Vector math engine.
+ *
+ * Every function below is a branch-free polynomial approximation in the
+ * style of fdlibm/SLEEF: special cases are handled with selects instead
+ * of ifs, so that GCC can vectorize the per-block loops in vm_chain_block.
+ * Elements are processed in blocks of VM_BLOCK so the intermediate arrays
+ * stay in L1. The only scalar path left is the trigonometric fallback for
+ * arguments beyond VM_TRIG_MAX, where the Cody-Waite reduction runs out
+ * of precision; those lanes are recomputed with libm.
+ */
+
+#define VM_BLOCK 256
+#define VM_TRIG_MAX 0x1p20
+
+static inline uint64_t as_u64(double d) {
+    uint64_t u;
+    memcpy(&u, &d, sizeof u);
+    return u;
+}
+
+static inline double as_f64(uint64_t u) {
+    double d;
+    memcpy(&d, &u, sizeof d);
+    return d;
+}
+
+/* (int)x as the x86 conversion does it: INT_MIN for NaN and out of range
+ * values, so the result matches the scalar macro without relying on UB */
+static inline int to_int(double x) {
+    return (x > -2147483649.0 && x < 2147483648.0) ? (int)x : INT_MIN;
+}
+
+static const double ln2_hi = 6.93147180369123816490e-01;
+static const double ln2_lo = 1.90821492927058770002e-10;
+
+static inline double k_exp(double x) {
+    const double shift = 0x1.8p52;
+    /* k = round(x / ln2), read from the low mantissa bits of kd */
+    double kd = x * 1.44269504088896338700e+00 + shift;
+    double k = kd - shift;
+    double r = (x - k * ln2_hi) - k * ln2_lo;
+    double p = 1.0 + r * (1.0 + r * (1.0 / 2 + r * (1.0 / 6 + r * (1.0 / 24 + r * (1.0 / 120
+             + r * (1.0 / 720 + r * (1.0 / 5040 + r * (1.0 / 40320 + r * (1.0 / 362880
+             + r * (1.0 / 3628800 + r * (1.0 / 39916800 + r * (1.0 / 479001600
+             + r * (1.0 / 6227020800.0)))))))))))));
+    /* scale by 2^k in two steps so results down to the subnormals work;
+     * biased by 2048 so only logical shifts are needed */
+    uint64_t u = as_u64(kd) - as_u64(shift) + 2048;
+    double s1 = as_f64(((u >> 1) - 1) << 52);
+    double s2 = as_f64((u - (u >> 1) - 1) << 52);
+    double y = p * s1 * s2;
+    y = x > 7.09782712893383973096e+02 ? INFINITY : y;
+    y = x < -7.45133219101941108420e+02 ? 0.0 : y;
+    return x != x ? x : y;
+}
+
+/* x = 2^e * m with m in [sqrt(2)/2, sqrt(2)), log(m) = f - hfsq + s*(hfsq+R) */
+static inline void k_log_parts(double x, double *e, double *hi, double *lo) {
+    const double shift = 0x1.8p52;
+    const double Lg1 = 6.666666666666735130e-01, Lg2 = 3.999999999940941908e-01,
+                 Lg3 = 2.857142874366239149e-01, Lg4 = 2.222219843214978396e-01,
+                 Lg5 = 1.818357216161805012e-01, Lg6 = 1.531383769920937332e-01,
+                 Lg7 = 1.479819860511658591e-01;
+    int subnormal = x < 0x1p-1022;
+    double xs = subnormal ? x * 0x1p54 : x;
+    uint64_t ix = as_u64(xs);
+    uint64_t t = ix - 0x3fe6a09e667f3bcdULL + (1024ULL << 52);
+    uint64_t biased = t >> 52;
+    double m = as_f64(ix - (biased << 52) + (1024ULL << 52));
+    double ed = as_f64(as_u64(shift) + biased) - shift - 1024.0;
+    *e = subnormal ? ed - 54.0 : ed;
+    double f = m - 1.0;
+    double s = f / (2.0 + f);
+    double z = s * s;
+    double w = z * z;
+    double R = z * (Lg1 + w * (Lg3 + w * (Lg5 + w * Lg7))) + w * (Lg2 + w * (Lg4 + w * Lg6));
+    double hfsq = 0.5 * f * f;
+    *hi = f;
+    *lo = s * (hfsq + R) - hfsq;
+}
+
+static inline double k_log_special(double x, double y) {
+    y = x == 0.0 ? -INFINITY : y;
+    y = x < 0.0 ? NAN : y;
+    y = x == INFINITY ? x : y;
+    return x != x ? x : y;
+}
+
+static inline double k_log(double x) {
+    double e, hi, lo;
+    k_log_parts(x, &e, &hi, &lo);
+    return k_log_special(x, e * ln2_hi + ((e * ln2_lo + lo) + hi));
+}
+
+static inline double k_log2(double x) {
+    const double ivln2 = 1.44269504088896338700e+00;
+    double e, hi, lo;
+    k_log_parts(x, &e, &hi, &lo);
+    return k_log_special(x, e + (hi + lo) * ivln2);
+}
+
+static inline double k_log10(double x) {
+    const double log10_2hi = 3.01029995663611771306e-01;
+    const double log10_2lo = 3.69423907715893078616e-13;
+    const double ivln10 = 4.34294481903251816668e-01;
+    double e, hi, lo;
+    k_log_parts(x, &e, &hi, &lo);
+    return k_log_special(x, e * log10_2hi + (e * log10_2lo + (hi + lo) * ivln10));
+}
+
+/* log(1 + u) with the rounding error of 1 + u corrected */
+static inline double k_log1p(double u) {
+    double w = 1.0 + u;
+    double c = (u - (w - 1.0)) / w;
+    return k_log(w) + ((w > 0.0 && w < INFINITY) ? c : 0.0);
+}
+
+/* sin and cos of r in [-pi/4, pi/4] */
+static inline double k_sin_poly(double r) {
+    const double S1 = -1.66666666666666324348e-01, S2 = 8.33333333332248946124e-03,
+                 S3 = -1.98412698298579493134e-04, S4 = 2.75573137070700676789e-06,
+                 S5 = -2.50507602534068634195e-08, S6 = 1.58969099521155010221e-10;
+    double z = r * r;
+    return r + r * z * (S1 + z * (S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)))));
+}
+
+static inline double k_cos_poly(double r) {
+    const double C1 = 4.16666666666666019037e-02, C2 = -1.38888888888741095749e-03,
+                 C3 = 2.48015872894767294178e-05, C4 = -2.75573143513906633035e-07,
+                 C5 = 2.08757232129817482790e-09, C6 = -1.13596475577881948265e-11;
+    double z = r * r;
+    double p = z * (C1 + z * (C2 + z * (C3 + z * (C4 + z * (C5 + z * C6)))));
+    double hz = 0.5 * z;
+    double w = 1.0 - hz;
+    return w + (((1.0 - w) - hz) + z * p);
+}
+
+/* x = k*pi/2 + r, three-part Cody-Waite reduction exact for |k| < 2^20 */
+static inline double k_reduce(double x, uint64_t *quadrant) {
+    const double shift = 0x1.8p52;
+    const double pio2_1 = 1.57079632673412561417e+00;
+    const double pio2_2 = 6.07710050630396597660e-11;
+    const double pio2_3 = 2.02226624871116645580e-21;
+    double kd = x * 6.36619772367581382433e-01 + shift;
+    double k = kd - shift;
+    *quadrant = (as_u64(kd) - as_u64(shift)) & 3;
+    return ((x - k * pio2_1) - k * pio2_2) - k * pio2_3;
+}
+
+/* quadrant bits turned into masks, so no 64-bit compares are needed */
+static inline double k_select(uint64_t mask, double a, double b) {
+    return as_f64((as_u64(a) & mask) | (as_u64(b) & ~mask));
+}
+
+static inline double k_flip(uint64_t bit, double a) {
+    return as_f64(as_u64(a) ^ (bit << 63));
+}
+
+static inline double k_sin(double x) {
+    uint64_t q;
+    double r = k_reduce(x, &q);
+    double y = k_select(0 - (q & 1), k_cos_poly(r), k_sin_poly(r));
+    return k_flip((q >> 1) & 1, y);
+}
+
+static inline double k_cos(double x) {
+    uint64_t q;
+    double r = k_reduce(x, &q);
+    double y = k_select(0 - (q & 1), k_sin_poly(r), k_cos_poly(r));
+    return k_flip(((q + 1) >> 1) & 1, y);
+}
+
+static inline double k_tan(double x) {
+    uint64_t q;
+    double r = k_reduce(x, &q);
+    double s = k_sin_poly(r), c = k_cos_poly(r);
+    uint64_t odd = 0 - (q & 1);
+    return k_flip(q & 1, k_select(odd, c, s) / k_select(odd, s, c));
+}
+
+/* fdlibm atan: reduce |x| to one of five intervals, then a degree 22
+ * odd polynomial; the interval is picked with selects */
+static inline double k_atan(double x) {
+    const double aT0 = 3.33333333333329318027e-01, aT1 = -1.99999999998764832476e-01,
+                 aT2 = 1.42857142725034663711e-01, aT3 = -1.11111104054623557880e-01,
+                 aT4 = 9.09088713343650656196e-02, aT5 = -7.69187620504482999495e-02,
+                 aT6 = 6.66107313738753120669e-02, aT7 = -5.83357013379057348645e-02,
+                 aT8 = 4.97687799461593236017e-02, aT9 = -3.65315727442169155270e-02,
+                 aT10 = 1.62858201153657823623e-02;
+    double ax = fabs(x);
+    double num = ax, den = 1.0, hi = 0.0, lo = 0.0;
+    num = ax >= 0.4375 ? 2.0 * ax - 1.0 : num;
+    den = ax >= 0.4375 ? 2.0 + ax : den;
+    hi = ax >= 0.4375 ? 4.63647609000806093515e-01 : hi;
+    lo = ax >= 0.4375 ? 2.26987774529616870924e-17 : lo;
+    num = ax >= 0.6875 ? ax - 1.0 : num;
+    den = ax >= 0.6875 ? ax + 1.0 : den;
+    hi = ax >= 0.6875 ? 7.85398163397448278999e-01 : hi;
+    lo = ax >= 0.6875 ? 3.06161699786838301793e-17 : lo;
+    num = ax >= 1.1875 ? ax - 1.5 : num;
+    den = ax >= 1.1875 ? 1.0 + 1.5 * ax : den;
+    hi = ax >= 1.1875 ? 9.82793723247329054082e-01 : hi;
+    lo = ax >= 1.1875 ? 1.39033110312309984516e-17 : lo;
+    /* NaN fails every comparison above and ends up here too */
+    num = !(ax < 2.4375) ? -1.0 : num;
+    den = !(ax < 2.4375) ? ax : den;
+    hi = !(ax < 2.4375) ? 1.57079632679489655800e+00 : hi;
+    lo = !(ax < 2.4375) ? 6.12323399573676603587e-17 : lo;
+    double t = num / den;
+    double z = t * t;
+    double w = z * z;
+    double s1 = z * (aT0 + w * (aT2 + w * (aT4 + w * (aT6 + w * (aT8 + w * aT10)))));
+    double s2 = w * (aT1 + w * (aT3 + w * (aT5 + w * (aT7 + w * aT9))));
+    return copysign(hi - ((t * (s1 + s2) - lo) - t), x);
+}
+
+static inline double k_asin(double x) {
+    return k_atan(x / sqrt((1.0 - x) * (1.0 + x)));
+}
+
+static inline double k_acos(double x) {
+    return 2.0 * k_atan(sqrt((1.0 - x) / (1.0 + x)));
+}
+
+/* odd and even Taylor series for |x| < 0.5, where e^x - e^-x cancels */
+static inline double k_sinh_poly(double x) {
+    double z = x * x;
+    return x + x * z * (1.0 / 6 + z * (1.0 / 120 + z * (1.0 / 5040 + z * (1.0 / 362880
+             + z * (1.0 / 39916800 + z * (1.0 / 6227020800.0 + z * (1.0 / 1307674368000.0)))))));
+}
+
+static inline double k_sinh(double x) {
+    double ax = fabs(x);
+    double e = k_exp(ax);
+    double h = k_exp(0.5 * ax);
+    double y = 0.5 * (e - 1.0 / e);
+    y = ax > 22.0 ? (0.5 * h) * h : y;
+    y = ax < 0.5 ? k_sinh_poly(ax) : y;
+    return copysign(y, x);
+}
+
+static inline double k_cosh(double x) {
+    double ax = fabs(x);
+    double e = k_exp(ax);
+    double h = k_exp(0.5 * ax);
+    double y = 0.5 * (e + 1.0 / e);
+    return ax > 22.0 ? (0.5 * h) * h : y;
+}
+
+static inline double k_tanh(double x) {
+    double ax = fabs(x);
+    double e = k_exp(2.0 * ax);
+    double y = 1.0 - 2.0 / (e + 1.0);
+    y = ax < 0.5 ? k_sinh_poly(ax) / (0.5 * (k_exp(ax) + k_exp(-ax))) : y;
+    return copysign(y, x);
+}
+
+static inline double k_asinh(double x) {
+    double ax = fabs(x);
+    double y = k_log1p(ax + ax * ax / (1.0 + sqrt(1.0 + ax * ax)));
+    y = ax > 0x1p28 ? k_log(ax) + 6.93147180559945286227e-01 : y;
+    return copysign(y, x);
+}
+
+static inline double k_acosh(double x) {
+    double t = x - 1.0;
+    double y = k_log1p(t + sqrt(2.0 * t + t * t));
+    y = x > 0x1p28 ? k_log(x) + 6.93147180559945286227e-01 : y;
+    return x < 1.0 ? NAN : y;
+}
+
+static inline double k_atanh(double x) {
+    double ax = fabs(x);
+    return copysign(0.5 * k_log1p(2.0 * ax / (1.0 - ax)), x);
+}
+
+#define VM_DEFINE(name, kernel) \
+    static void name(const double *restrict x, double *restrict y, int n) { \
+        for (int i = 0; i < n; i++) { \
+            y[i] = kernel(x[i]); \
+        } \
     }
 
+#define VM_DEFINE_TRIG(name, kernel, fallback) \
+    static void name(const double *restrict x, double *restrict y, int n) { \
+        for (int i = 0; i < n; i++) { \
+            y[i] = kernel(x[i]); \
+        } \
+        for (int i = 0; i < n; i++) { \
+            if (!(fabs(x[i]) <= VM_TRIG_MAX)) { \
+                y[i] = fallback(x[i]); \
+            } \
+        } \
+    }
+
+static double vm_sqrt_kernel(double x) {
+    return sqrt(x);
+}
+
+VM_DEFINE_TRIG(vm_tan, k_tan, tan)
+VM_DEFINE_TRIG(vm_sin, k_sin, sin)
+VM_DEFINE_TRIG(vm_cos, k_cos, cos)
+VM_DEFINE(vm_tanh, k_tanh)
+VM_DEFINE(vm_sinh, k_sinh)
+VM_DEFINE(vm_cosh, k_cosh)
+VM_DEFINE(vm_atan, k_atan)
+VM_DEFINE(vm_asin, k_asin)
+VM_DEFINE(vm_acos, k_acos)
+VM_DEFINE(vm_atanh, k_atanh)
+VM_DEFINE(vm_asinh, k_asinh)
+VM_DEFINE(vm_acosh, k_acosh)
+VM_DEFINE(vm_exp, k_exp)
+VM_DEFINE(vm_log, k_log)
+VM_DEFINE(vm_log10, k_log10)
+VM_DEFINE(vm_log2, k_log2)
+VM_DEFINE(vm_sqrt, vm_sqrt_kernel)
+
+/* the chain of DO_COMPLEX_CALCULATIONS, in the same order */
+struct vm_function {
+    const char *name;
+    void (*vector)(const double *restrict, double *restrict, int);
+    double (*scalar)(double);
+    double lo, hi; /* range sampled by the accuracy check */
+};
+
+static const struct vm_function vm_chain[] = {
+    {"tan", vm_tan, tan, -1e4, 1e4},
+    {"sin", vm_sin, sin, -1e4, 1e4},
+    {"cos", vm_cos, cos, -1e4, 1e4},
+    {"tanh", vm_tanh, tanh, -30, 30},
+    {"sinh", vm_sinh, sinh, -710, 710},
+    {"cosh", vm_cosh, cosh, -710, 710},
+    {"atan", vm_atan, atan, -100, 100},
+    {"asin", vm_asin, asin, -1, 1},
+    {"acos", vm_acos, acos, -1, 1},
+    {"atanh", vm_atanh, atanh, -1, 1},
+    {"asinh", vm_asinh, asinh, -1e3, 1e3},
+    {"acosh", vm_acosh, acosh, 1, 1e3},
+    {"exp", vm_exp, exp, -745, 709},
+    {"log", vm_log, log, 0, 1e4},
+    {"log10", vm_log10, log10, 0, 1e4},
+    {"log2", vm_log2, log2, 0, 1e4},
+    {"sqrt", vm_sqrt, sqrt, 0, 1e4},
+};
+
+#define VM_CHAIN_LENGTH (int)(sizeof(vm_chain) / sizeof(vm_chain[0]))
+
+/* out[i] = DO_COMPLEX_CALCULATIONS(in[i]) for n <= VM_BLOCK elements.
+ * The sum wraps like the int additions of the macro do on x86. */
+static void vm_chain_block(const int *in, int *out, int n) {
+    double x[VM_BLOCK], y[VM_BLOCK];
+    unsigned acc[VM_BLOCK];
+    for (int i = 0; i < n; i++) {
+        x[i] = (double)in[i];
+        acc[i] = 0;
+    }
+    for (int f = 0; f < VM_CHAIN_LENGTH; f++) {
+        vm_chain[f].vector(x, y, n);
+        for (int i = 0; i < n; i++) {
+            acc[i] += (unsigned)to_int(y[i]);
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        out[i] = (int)acc[i];
+    }
+}
+
+static int scalar_chain(int value) {
+    double x = (double)value;
+    unsigned acc = 0;
+    for (int f = 0; f < VM_CHAIN_LENGTH; f++) {
+        acc += (unsigned)to_int(vm_chain[f].scalar(x));
+    }
+    return (int)acc;
+}
+
+void * vm_add_to_arr(void *n) {
+    int start, end;
+    partition(*(int *) n, &start, &end);
+    for (int i = start; i < end; i += VM_BLOCK) {
+        int count = end - i < VM_BLOCK ? end - i : VM_BLOCK;
+        vm_chain_block(arr + i, arr3 + i, count);
+    }
+    return NULL;
+}
+
+/*
+ * Value cache. Each thread keeps a small direct-mapped table from input
+ * value to the chain result; a hit replaces 17 transcendental calls by one
+ * probe. It only pays off when inputs repeat, so hits and misses are
+ * counted per thread to show the hit rate next to the timings.
+ */
+
+int cache_bits = 0; /* 0: no cache, else 2^cache_bits entries per thread */
+
+struct cache_entry {
+    int key;
+    int value;
+    int valid;
+};
+
+/* one per thread, padded so the counters do not share a cache line */
+struct cache_stats {
+    long hits;
+    long misses;
+    char padding[64 - 2 * sizeof(long)];
+};
+
+struct cache_stats *cache_stats;
+
+static inline unsigned cache_slot(int key) {
+    return ((unsigned)key * 2654435761u) >> (32 - cache_bits);
+}
+
+void * memo_add_to_arr(void *n) {
+    int id = *(int *) n;
+    int start, end;
+    long hits = 0;
+    partition(id, &start, &end);
+    struct cache_entry *cache = calloc((size_t)1 << cache_bits, sizeof(struct cache_entry));
+    for (int i = start; i < end; i++) {
+        struct cache_entry *e = &cache[cache_slot(arr[i])];
+        if (e->valid && e->key == arr[i]) {
+            hits++;
+        } else {
+            e->key = arr[i];
+            e->value = DO_COMPLEX_CALCULATIONS(arr[i]);
+            e->valid = 1;
+        }
+        arr2[i] = e->value;
+    }
+    free(cache);
+    cache_stats[id].hits = hits;
+    cache_stats[id].misses = (end - start) - hits;
+    return NULL;
+}
+
+/* the vector engine behind the cache: misses of a block are gathered
+ * and computed together, so they still run vectorized */
+void * vm_memo_add_to_arr(void *n) {
+    int id = *(int *) n;
+    int start, end;
+    long hits = 0;
+    partition(id, &start, &end);
+    struct cache_entry *cache = calloc((size_t)1 << cache_bits, sizeof(struct cache_entry));
+    int miss_index[VM_BLOCK], miss_in[VM_BLOCK], miss_out[VM_BLOCK];
+    for (int block = start; block < end; block += VM_BLOCK) {
+        int count = end - block < VM_BLOCK ? end - block : VM_BLOCK;
+        int misses = 0;
+        for (int i = block; i < block + count; i++) {
+            struct cache_entry *e = &cache[cache_slot(arr[i])];
+            if (e->valid && e->key == arr[i]) {
+                hits++;
+                arr3[i] = e->value;
+            } else {
+                miss_index[misses] = i;
+                miss_in[misses++] = arr[i];
+            }
+        }
+        vm_chain_block(miss_in, miss_out, misses);
+        for (int m = 0; m < misses; m++) {
+            struct cache_entry *e = &cache[cache_slot(miss_in[m])];
+            e->key = miss_in[m];
+            e->value = miss_out[m];
+            e->valid = 1;
+            arr3[miss_index[m]] = miss_out[m];
+        }
+    }
+    free(cache);
+    cache_stats[id].hits = hits;
+    cache_stats[id].misses = (end - start) - hits;
+    return NULL;
+}
+
+double cache_hit_rate(void) {
+    long hits = 0, misses = 0;
+    for (int i = 0; i < nthreads; i++) {
+        hits += cache_stats[i].hits;
+        misses += cache_stats[i].misses;
+    }
+    return hits + misses > 0 ? (double)hits / (hits + misses) : 0.0;
+}
+
+/* ulps between y and the libm result ref */
+static double ulp_error(double y, double ref) {
+    if (y == ref || (y != y && ref != ref)) {
+        return 0.0;
+    }
+    if (isinf(ref) || isinf(y) || y != y || ref != ref) {
+        return INFINITY;
+    }
+    double ulp = nextafter(fabs(ref), INFINITY) - fabs(ref);
+    return fabs(y - ref) / ulp;
+}
+
+/* max error of every vector function against libm over random arguments
+ * from its sample range plus the integers -1000..1000 */
+static void check_accuracy(void) {
+    enum { SAMPLES = 100000, INTEGERS = 2001 };
+    static double x[SAMPLES + INTEGERS], y[SAMPLES + INTEGERS];
+    int total = SAMPLES + INTEGERS;
+    unsigned seed = 1;
+
+    printf("Accuracy against libm (%d arguments per function)\n", total);
+    for (int f = 0; f < VM_CHAIN_LENGTH; f++) {
+        const struct vm_function *fn = &vm_chain[f];
+        for (int i = 0; i < SAMPLES; i++) {
+            double r = (double)rand_r(&seed) / RAND_MAX;
+            x[i] = fn->lo + (fn->hi - fn->lo) * r;
+        }
+        for (int i = 0; i < INTEGERS; i++) {
+            x[SAMPLES + i] = i - 1000;
+        }
+        for (int i = 0; i < total; i += VM_BLOCK) {
+            fn->vector(x + i, y + i, total - i < VM_BLOCK ? total - i : VM_BLOCK);
+        }
+        double worst = 0.0, worst_x = 0.0;
+        int truncation_mismatches = 0;
+        for (int i = 0; i < total; i++) {
+            double ref = fn->scalar(x[i]);
+            double err = ulp_error(y[i], ref);
+            if (err > worst) {
+                worst = err;
+                worst_x = x[i];
+            }
+            if (to_int(y[i]) != to_int(ref)) {
+                truncation_mismatches++;
+            }
+        }
+        printf("  %-6s max %.2f ulp (at %g), %d truncation mismatches\n",
+               fn->name, worst, worst_x, truncation_mismatches);
+    }
+}
+
+double seconds_since(struct timeval *start) {
+    struct timeval finish;
     gettimeofday(&finish, NULL);
-    double elapsed = ((double)(finish.tv_usec - start.tv_usec) / 1000000.0) + finish.tv_sec - start.tv_sec;
+    return ((double)(finish.tv_usec - start->tv_usec) / 1000000.0) + finish.tv_sec - start->tv_sec;
+}
 
-    printf("time elapsed %lf seconds\n", (double)elapsed);
+/* the sequential baseline: DO_COMPLEX_CALCULATIONS on one thread */
+double run_sequential(void) {
+    struct timeval start;
+    gettimeofday(&start, NULL);
+    for (int i = 0; i < arr_len; i++) {
+        arr2[i] = DO_COMPLEX_CALCULATIONS(arr[i]);
+    }
+    return seconds_since(&start);
+}
 
-    pthread_t * my_threads = malloc(nthreads * sizeof(pthread_t));
+/* run worker on nthreads threads over arr_len elements */
+double run_parallel(void * (*worker)(void *)) {
+    pthread_t my_threads[nthreads];
+    int ids[nthreads];
+    struct timeval start;
 
     gettimeofday(&start, NULL);
 	for (long i = 0; i < nthreads; i++) {
 		ids[i] = i;
-		pthread_create(&my_threads[i], NULL, add_to_arr, (void *)&ids[i]);
+		pthread_create(&my_threads[i], NULL, worker, (void *)&ids[i]);
 	}
-		
+
 	for (long i = 0; i < nthreads; i++) {
 		pthread_join(my_threads[i], NULL);
 	}
+    return seconds_since(&start);
+}
 
-    gettimeofday(&finish, NULL);
-    elapsed = ((double)(finish.tv_usec - start.tv_usec) / 1000000.0) + finish.tv_sec - start.tv_sec;
+/*
+ * Scaling sweep over 1, 2, 4, ... max_threads threads for both kernels.
+ * Strong scaling keeps the problem at `elements` and compares against the
+ * sequential time for all of it. Weak scaling gives every thread
+ * elements / max_threads elements and compares against the sequential
+ * time for one thread's share, so the ideal time stays constant.
+ */
+void sweep(int weak, int max_threads, int elements) {
+    int share = weak ? elements / max_threads : elements;
+
+    arr_len = share;
+    double baseline = run_sequential();
+    printf("%s scaling, %d elements%s, sequential baseline %lf seconds\n",
+           weak ? "weak" : "strong", share, weak ? " per thread" : "", baseline);
+    printf("%8s %10s %12s %14s %8s %10s\n",
+           "threads", "kernel", "seconds", "elements/sec", "speedup", "efficiency");
+
+    for (int t = 1; ; t *= 2) {
+        if (t > max_threads) {
+            t = max_threads;
+        }
+        nthreads = t;
+        arr_len = weak ? share * t : share;
+        for (int k = 0; k < 2; k++) {
+            double elapsed = run_parallel(k == 0 ? add_to_arr : vm_add_to_arr);
+            /* weak: speedup is the scaled speedup, t times the efficiency */
+            double efficiency = weak ? baseline / elapsed : baseline / elapsed / t;
+            printf("%8d %10s %12lf %14.3g %8.2f %9.1f%%\n", t, k == 0 ? "libm" : "vector",
+                   elapsed, arr_len / elapsed, efficiency * t, 100.0 * efficiency);
+        }
+        if (t == max_threads) {
+            break;
+        }
+    }
+}
+
+/* elements whose chain result differs from scalar_chain */
+long count_mismatches(int *out) {
+    long mismatches = 0;
+    for (int i = 0; i < arr_len; i++) {
+        if (out[i] != scalar_chain(arr[i])) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+void usage(char *name) {
+    fprintf(stderr, "usage: %s [-s | -w] [-c ENTRIES] [-d K] [nthreads] [elements]\n", name);
+    fprintf(stderr, "  -s  strong scaling sweep over 1, 2, 4, ... nthreads threads\n");
+    fprintf(stderr, "  -w  weak scaling sweep, elements / nthreads per thread\n");
+    fprintf(stderr, "  -c  also run both kernels behind a per-thread value cache\n");
+    fprintf(stderr, "      of ENTRIES entries (rounded up to a power of two)\n");
+    fprintf(stderr, "  -d  draw the input from K distinct values around 0 instead\n");
+    fprintf(stderr, "      of all zeros\n");
+    exit(1);
+}
+
+int main (int argc, char ** argv) {
+    int strong = 0, weak = 0;
+    int cache_entries = 0, distinct = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "swc:d:")) != -1) {
+        switch (opt) {
+        case 's':
+            strong = 1;
+            break;
+        case 'w':
+            weak = 1;
+            break;
+        case 'c':
+            cache_entries = atoi(optarg);
+            if (cache_entries < 1 || cache_entries > (1 << 30)) {
+                usage(argv[0]);
+            }
+            while ((1 << cache_bits) < cache_entries) {
+                cache_bits++;
+            }
+            /* cache_slot shifts by 32 - cache_bits */
+            if (cache_bits == 0) {
+                cache_bits = 1;
+            }
+            break;
+        case 'd':
+            distinct = atoi(optarg);
+            if (distinct < 1) {
+                usage(argv[0]);
+            }
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind < argc)
+        nthreads = atoi(argv[optind++]);
+    if (optind < argc)
+        arr_len = atoi(argv[optind++]);
+    if (optind < argc || nthreads < 1 || arr_len < 1 || (strong && weak) || (weak && arr_len < nthreads)) {
+        usage(argv[0]);
+    }
+
+    arr = calloc(arr_len * sizeof(int), 1);
+    arr2 = calloc(arr_len * sizeof(int), 1);
+    arr3 = calloc(arr_len * sizeof(int), 1);
+    if (arr == NULL || arr2 == NULL || arr3 == NULL) {
+        fprintf(stderr, "cannot allocate %d elements\n", arr_len);
+        return 1;
+    }
+    if (distinct > 1) {
+        unsigned seed = 1;
+        for (int i = 0; i < arr_len; i++) {
+            arr[i] = rand_r(&seed) % distinct - distinct / 2;
+        }
+    }
+
+    if (strong || weak) {
+        sweep(weak, nthreads, arr_len);
+        free(arr);
+        free(arr2);
+        free(arr3);
+        return 0;
+    }
+
+    printf("Starting Computation\n");
+    double elapsed = run_sequential();
+    printf("time elapsed %lf seconds, %.3g elements/sec\n", (double)elapsed, arr_len / elapsed);
+
+    elapsed = run_parallel(add_to_arr);
+    printf("time elapsed %lf seconds, %.3g elements/sec\n", (double)elapsed, arr_len / elapsed);
+
+    elapsed = run_parallel(vm_add_to_arr);
+    printf("vector engine, %d threads: time elapsed %lf seconds, %.3g elements/sec\n",
+           nthreads, elapsed, arr_len / elapsed);
+
+    /* the vector engine has to reproduce the scalar chain exactly */
+    printf("%ld of %d elements differ from the scalar libm chain\n", count_mismatches(arr3), arr_len);
+
+    if (cache_bits > 0) {
+        cache_stats = calloc(nthreads, sizeof(struct cache_stats));
+        elapsed = run_parallel(memo_add_to_arr);
+        printf("libm + cache, %d threads: time elapsed %lf seconds, %.3g elements/sec, hit rate %.2f%%, %ld mismatches\n",
+               nthreads, elapsed, arr_len / elapsed, 100.0 * cache_hit_rate(), count_mismatches(arr2));
+        elapsed = run_parallel(vm_memo_add_to_arr);
+        printf("vector + cache, %d threads: time elapsed %lf seconds, %.3g elements/sec, hit rate %.2f%%, %ld mismatches\n",
+               nthreads, elapsed, arr_len / elapsed, 100.0 * cache_hit_rate(), count_mismatches(arr3));
+        free(cache_stats);
+    }
 
-    printf("time elapsed %lf seconds\n", (double)elapsed);
+    check_accuracy();
 
+    free(arr);
+    free(arr2);
+    free(arr3);
     return 0;
 }
@@ -0,0 +1,579 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "logger.hpp"
+
+/*
+ * Dining philosophers simulator.
+ *
+ * N philosophers sit in a circle, philosopher i shares fork i with her
+ * left and fork i-1 with her right neighbour. Every philosopher thinks,
+ * gets hungry, acquires both forks using the selected protocol, eats and
+ * puts the forks back, for a fixed number of seconds. The time from
+ * getting hungry to eating is recorded per philosopher.
+ *
+ * Protocols:
+ *   ordering      take the lower numbered fork first (no cycle, no deadlock)
+ *   backoff       take the left fork, try the right one; on failure put the
+ *                 left one down and sleep for a random time below an
+ *                 exponentially growing bound
+ *   waiter        a single arbitrator hands out both forks at once, only
+ *                 when both are free
+ *   chandy-misra  forks are clean or dirty; a dirty fork is handed over on
+ *                 request unless its holder is eating, a clean one is kept
+ *                 until its holder has eaten (Chandy and Misra, 1984)
+ */
+
+typedef std::chrono::steady_clock sim_clock;
+
+enum event { thinking, hungry, eating, backing_off };
+
+const std::vector<std::string> event_messages = {
+  "is thinking.",
+  "is hungry.",
+  "is eating.",
+  "is backing off.",
+};
+
+enum protocol { ordering, backoff, waiter, chandy_misra };
+
+struct options
+{
+  protocol proto = ordering;
+  int philosophers = 0;
+  int seconds = 5;
+  int eat_us = 100;   // mean eating time
+  int think_us = 100; // mean thinking time
+  bool verbose = false;
+};
+
+/* log-linear histogram of nanoseconds: exact below 16, then 8 buckets
+ * per power of two, so percentiles are within 12.5% */
+class wait_histogram
+{
+public:
+  static const int buckets = 16 + 60 * 8;
+
+  wait_histogram() : counts(buckets, 0) {}
+
+  void add(std::uint64_t ns)
+  {
+    counts[index(ns)]++;
+  }
+
+  void merge(const wait_histogram& other)
+  {
+    for (int b = 0; b < buckets; ++b)
+      {
+        counts[b] += other.counts[b];
+      }
+  }
+
+  std::uint64_t total() const
+  {
+    std::uint64_t sum = 0;
+    for (auto c : counts)
+      {
+        sum += c;
+      }
+    return sum;
+  }
+
+  /* lower bound of the bucket holding the q-th quantile */
+  std::uint64_t percentile(double q) const
+  {
+    std::uint64_t rank = (std::uint64_t)std::ceil(q * total());
+    std::uint64_t seen = 0;
+    for (int b = 0; b < buckets; ++b)
+      {
+        seen += counts[b];
+        if (seen >= rank && counts[b] > 0)
+          {
+            return lower_bound(b);
+          }
+      }
+    return 0;
+  }
+
+private:
+  static int index(std::uint64_t ns)
+  {
+    if (ns < 16)
+      {
+        return (int)ns;
+      }
+    int log = 63 - __builtin_clzll(ns);
+    return std::min(buckets - 1, 16 + (log - 4) * 8 + (int)((ns >> (log - 3)) & 7));
+  }
+
+  static std::uint64_t lower_bound(int b)
+  {
+    if (b < 16)
+      {
+        return b;
+      }
+    int log = (b - 16) / 8 + 4;
+    return (std::uint64_t)(8 + (b - 16) % 8) << (log - 3);
+  }
+
+  std::vector<std::uint64_t> counts;
+};
+
+static const std::size_t CACHE_LINE_SIZE = 64;
+
+/* written only by its philosopher, read after she has been joined.
+ * The padding keeps the counters of neighbouring entries in a vector at
+ * least a cache line apart, std::vector does not honour alignas in C++11 */
+struct philosopher_stats
+{
+  unsigned long meals = 0;
+  unsigned long attempts = 0; // failed try-locks (backoff only)
+  std::uint64_t max_wait = 0;
+  wait_histogram waits;
+  char padding[CACHE_LINE_SIZE];
+};
+
+/* per-philosopher wake-up for the waiter and Chandy-Misra protocols */
+struct doorbell
+{
+  std::mutex m;
+  std::condition_variable cv;
+  unsigned long rings = 0;
+
+  unsigned long current()
+  {
+    std::lock_guard<std::mutex> lock(m);
+    return rings;
+  }
+
+  void ring()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m);
+      rings++;
+    }
+    cv.notify_one();
+  }
+
+  /* wait for a ring after `seen`, at most 1ms so the run can end */
+  void wait(unsigned long seen)
+  {
+    std::unique_lock<std::mutex> lock(m);
+    cv.wait_for(lock, std::chrono::milliseconds(1), [&]() { return rings != seen; });
+  }
+};
+
+struct cm_fork
+{
+  std::mutex m;
+  int holder;     // philosopher that owns the fork
+  bool dirty;
+  bool requested; // the other philosopher asked for it
+};
+
+class table
+{
+public:
+  explicit table(const options& opt)
+    : opt(opt), n(opt.philosophers), forks(new std::mutex[n]),
+      fork_in_use(n, false), bells(new doorbell[n]), cm_forks(new cm_fork[n]),
+      state(new std::atomic<int>[n]), running(true)
+  {
+    for (int f = 0; f < n; ++f)
+      {
+        /* every fork starts dirty at the lower numbered philosopher, which
+         * makes the precedence graph acyclic as Chandy-Misra requires */
+        cm_forks[f].holder = std::min(left_owner(f), right_owner(f));
+        cm_forks[f].dirty = true;
+        cm_forks[f].requested = false;
+        state[f].store(thinking, std::memory_order_relaxed);
+      }
+  }
+
+  int left(int i) const { return i; }
+  int right(int i) const { return (i == 0 ? n : i) - 1; }
+  /* the two philosophers sharing fork f */
+  int left_owner(int f) const { return f; }
+  int right_owner(int f) const { return f + 1 == n ? 0 : f + 1; }
+
+  bool is_running() const
+  {
+    return running.load(std::memory_order_relaxed);
+  }
+
+  void stop()
+  {
+    running.store(false, std::memory_order_relaxed);
+  }
+
+  /* returns false if the run ended before both forks were taken */
+  bool acquire(int i, std::minstd_rand& rng, philosopher_stats& stats, ring_logger& log)
+  {
+    switch (opt.proto)
+      {
+      case ordering:
+        {
+          int first = std::min(left(i), right(i));
+          int second = std::max(left(i), right(i));
+          forks[first].lock();
+          forks[second].lock();
+          return true;
+        }
+      case backoff:
+        {
+          int bound_us = 1;
+          while (is_running())
+            {
+              forks[left(i)].lock();
+              if (forks[right(i)].try_lock())
+                {
+                  return true;
+                }
+              forks[left(i)].unlock();
+              stats.attempts++;
+              log.log(i, backing_off);
+              std::uniform_int_distribution<int> pause(0, bound_us);
+              std::this_thread::sleep_for(std::chrono::microseconds(pause(rng)));
+              bound_us = std::min(2 * bound_us, 1000);
+            }
+          return false;
+        }
+      case waiter:
+        while (is_running())
+          {
+            unsigned long seen = bells[i].current();
+            {
+              std::lock_guard<std::mutex> lock(waiter_mutex);
+              if (!fork_in_use[left(i)] && !fork_in_use[right(i)])
+                {
+                  fork_in_use[left(i)] = fork_in_use[right(i)] = true;
+                  return true;
+                }
+            }
+            bells[i].wait(seen);
+          }
+        return false;
+      case chandy_misra:
+        state[i].store(hungry, std::memory_order_relaxed);
+        while (is_running())
+          {
+            unsigned long seen = bells[i].current();
+            /* & rather than &&: ask for both forks even if the first is missing */
+            if (cm_request(i, left(i)) & cm_request(i, right(i)) && cm_start_eating(i))
+              {
+                return true;
+              }
+            bells[i].wait(seen);
+          }
+        state[i].store(thinking, std::memory_order_relaxed);
+        return false;
+      }
+    return false;
+  }
+
+  void release(int i)
+  {
+    switch (opt.proto)
+      {
+      case ordering:
+      case backoff:
+        forks[left(i)].unlock();
+        forks[right(i)].unlock();
+        break;
+      case waiter:
+        {
+          std::lock_guard<std::mutex> lock(waiter_mutex);
+          fork_in_use[left(i)] = fork_in_use[right(i)] = false;
+        }
+        bells[other(left(i), i)].ring();
+        bells[other(right(i), i)].ring();
+        break;
+      case chandy_misra:
+        cm_finish_eating(i);
+        break;
+      }
+  }
+
+private:
+  int other(int f, int i) const
+  {
+    return left_owner(f) == i ? right_owner(f) : left_owner(f);
+  }
+
+  /* true if i holds fork f afterwards; a dirty fork whose holder is not
+   * eating is taken over directly, otherwise the request is left on it */
+  bool cm_request(int i, int f)
+  {
+    cm_fork& fork = cm_forks[f];
+    std::lock_guard<std::mutex> lock(fork.m);
+    if (fork.holder == i)
+      {
+        return true;
+      }
+    if (fork.dirty && state[fork.holder].load(std::memory_order_relaxed) != eating)
+      {
+        fork.holder = i;
+        fork.dirty = false;
+        fork.requested = false;
+        return true;
+      }
+    fork.requested = true;
+    return false;
+  }
+
+  /* state changes to eating only with both fork mutexes held, so a
+   * neighbour checking the state under a fork mutex cannot race with it */
+  bool cm_start_eating(int i)
+  {
+    cm_fork& first = cm_forks[std::min(left(i), right(i))];
+    cm_fork& second = cm_forks[std::max(left(i), right(i))];
+    std::lock_guard<std::mutex> lock_first(first.m);
+    std::lock_guard<std::mutex> lock_second(second.m);
+    if (first.holder != i || second.holder != i)
+      {
+        return false; // a dirty fork was taken in between
+      }
+    state[i].store(eating, std::memory_order_relaxed);
+    return true;
+  }
+
+  void cm_finish_eating(int i)
+  {
+    int handed[2];
+    int count = 0;
+    {
+      cm_fork& first = cm_forks[std::min(left(i), right(i))];
+      cm_fork& second = cm_forks[std::max(left(i), right(i))];
+      std::lock_guard<std::mutex> lock_first(first.m);
+      std::lock_guard<std::mutex> lock_second(second.m);
+      for (int f : {left(i), right(i)})
+        {
+          cm_fork& fork = cm_forks[f];
+          fork.dirty = true;
+          if (fork.requested)
+            {
+              fork.holder = other(f, i);
+              fork.dirty = false;
+              fork.requested = false;
+              handed[count++] = fork.holder;
+            }
+        }
+      state[i].store(thinking, std::memory_order_relaxed);
+    }
+    for (int k = 0; k < count; ++k)
+      {
+        bells[handed[k]].ring();
+      }
+  }
+
+  const options& opt;
+  int n;
+  std::unique_ptr<std::mutex[]> forks;           // ordering, backoff
+  std::mutex waiter_mutex;                       // waiter
+  std::vector<bool> fork_in_use;
+  std::unique_ptr<doorbell[]> bells;             // waiter, chandy-misra
+  std::unique_ptr<cm_fork[]> cm_forks;           // chandy-misra
+  std::unique_ptr<std::atomic<int>[]> state;
+  std::atomic<bool> running;
+};
+
+void pause_around(int mean_us, std::minstd_rand& rng)
+{
+  if (mean_us > 0)
+    {
+      std::uniform_int_distribution<int> duration(0, 2 * mean_us);
+      std::this_thread::sleep_for(std::chrono::microseconds(duration(rng)));
+    }
+}
+
+void philosopher(int n, table *t, const options *opt, std::atomic<bool> *go,
+                 philosopher_stats *stats, ring_logger *log)
+{
+  std::minstd_rand rng(n + 1);
+  while (!go->load(std::memory_order_acquire))
+    {
+      std::this_thread::yield();
+    }
+  while (t->is_running())
+    {
+      log->log(n, thinking);
+      pause_around(opt->think_us, rng);
+
+      log->log(n, hungry);
+      auto hungry_since = sim_clock::now();
+      if (!t->acquire(n, rng, *stats, *log))
+        {
+          break;
+        }
+      std::uint64_t waited = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        sim_clock::now() - hungry_since).count();
+      stats->waits.add(waited);
+      stats->max_wait = std::max(stats->max_wait, waited);
+      stats->meals++;
+
+      log->log(n, eating);
+      pause_around(opt->eat_us, rng);
+      t->release(n);
+    }
+}
+
+void report(const options& opt, double seconds, const std::vector<philosopher_stats>& stats)
+{
+  static const char *names[] = { "ordering", "backoff", "waiter", "chandy-misra" };
+  std::vector<unsigned long> meals;
+  wait_histogram waits;
+  unsigned long total = 0, failed_attempts = 0;
+  double squares = 0.0;
+  std::uint64_t max_wait = 0;
+  for (auto& s : stats)
+    {
+      meals.push_back(s.meals);
+      total += s.meals;
+      squares += (double)s.meals * s.meals;
+      failed_attempts += s.attempts;
+      waits.merge(s.waits);
+      max_wait = std::max(max_wait, s.max_wait);
+    }
+  std::sort(meals.begin(), meals.end());
+  long starved = std::count(meals.begin(), meals.end(), 0UL);
+  /* Jain's index: 1 when every philosopher ate equally often, 1/N when
+   * a single one ate everything */
+  double fairness = squares > 0 ? (double)total * total / (meals.size() * squares) : 0.0;
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << names[opt.proto] << ", " << opt.philosophers << " philosophers, "
+            << seconds << " seconds" << std::endl;
+  std::cout << "meals: " << total << " (" << total / seconds << " meals/sec)" << std::endl;
+  std::cout << "meals per philosopher: min " << meals.front()
+            << ", median " << meals[meals.size() / 2]
+            << ", max " << meals.back()
+            << ", starved " << starved
+            << ", fairness " << std::setprecision(3) << fairness << std::endl;
+  if (opt.proto == backoff)
+    {
+      std::cout << "failed attempts: " << failed_attempts << std::endl;
+    }
+  std::cout << std::setprecision(1);
+  std::cout << "wait us: p50 " << waits.percentile(0.50) / 1e3
+            << ", p90 " << waits.percentile(0.90) / 1e3
+            << ", p99 " << waits.percentile(0.99) / 1e3
+            << ", p99.9 " << waits.percentile(0.999) / 1e3
+            << ", max " << max_wait / 1e3 << std::endl;
+}
+
+void usage(char *program)
+{
+  std::cout << "Usage: " << program << " [-p PROTOCOL] [-t SECONDS] [-e US] [-k US] [-v] N  (where N>=2)" << std::endl;
+  std::cout << "  -p  ordering, backoff, waiter or chandy-misra (default ordering)" << std::endl;
+  std::cout << "  -t  run time in seconds (default 5)" << std::endl;
+  std::cout << "  -e  mean eating time in microseconds (default 100)" << std::endl;
+  std::cout << "  -k  mean thinking time in microseconds (default 100)" << std::endl;
+  std::cout << "  -v  print every state change instead of per-second totals" << std::endl;
+  exit(1);
+}
+
+int read_int(char *program, const char *text, int min)
+{
+  int value = 0;
+  try
+    {
+      value = std::stoi(text);
+    }
+  catch (const std::exception&)
+    {
+      usage(program);
+    }
+  if (value < min)
+    {
+      usage(program);
+    }
+  return value;
+}
+
+int main(int argc, char *argv[])
+{
+  options opt;
+  int c;
+  while ((c = getopt(argc, argv, "p:t:e:k:v")) != -1)
+    {
+      switch (c)
+        {
+        case 'p':
+          {
+            std::string p = optarg;
+            if (p == "ordering")
+              opt.proto = ordering;
+            else if (p == "backoff")
+              opt.proto = backoff;
+            else if (p == "waiter")
+              opt.proto = waiter;
+            else if (p == "chandy-misra")
+              opt.proto = chandy_misra;
+            else
+              usage(argv[0]);
+            break;
+          }
+        case 't':
+          opt.seconds = read_int(argv[0], optarg, 1);
+          break;
+        case 'e':
+          opt.eat_us = read_int(argv[0], optarg, 0);
+          break;
+        case 'k':
+          opt.think_us = read_int(argv[0], optarg, 0);
+          break;
+        case 'v':
+          opt.verbose = true;
+          break;
+        default:
+          usage(argv[0]);
+        }
+    }
+  if (argc - optind != 1)
+    {
+      usage(argv[0]);
+    }
+  opt.philosophers = read_int(argv[0], argv[optind], 2);
+
+  /* counters mode never touches the rings, so keep them tiny */
+  ring_logger log(opt.philosophers, event_messages, "Philosopher ",
+                  opt.verbose ? ring_logger::print : ring_logger::counters,
+                  std::cout, opt.verbose ? 1 << 12 : 1);
+  table t(opt);
+  std::vector<philosopher_stats> stats(opt.philosophers);
+  std::atomic<bool> go(false);
+
+  std::vector<std::thread> ph;
+  for (int i = 0; i < opt.philosophers; ++i)
+    {
+      ph.push_back(std::thread(philosopher, i, &t, &opt, &go, &stats[i], &log));
+    }
+
+  auto start = sim_clock::now();
+  go.store(true, std::memory_order_release);
+  std::this_thread::sleep_for(std::chrono::seconds(opt.seconds));
+  t.stop();
+  for (auto& p : ph)
+    {
+      p.join();
+    }
+  double seconds = std::chrono::duration<double>(sim_clock::now() - start).count();
+  log.stop();
+
+  report(opt, seconds, stats);
+  log.report(std::cout);
+  return 0;
+}
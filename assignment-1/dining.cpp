@@ -1,67 +1,94 @@
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <thread>
 #include <mutex>
+#include <unistd.h>
 
-std::mutex out;
+#include "logger.hpp"
+
+enum event { thinking, picked_left, can_pick_right, putting_down_left, eating, putting_down_right };
+
+const std::vector<std::string> event_messages = {
+  "is thinking.",
+  "picked up her left fork.",
+  "can pick right fork.",
+  "is putting down her left fork.",
+  "is eating.",
+  "is putting down her right fork.",
+};
+
+ring_logger *out;
+std::atomic<bool> running(true);
 
 void philosopher(int n, std::mutex *left, std::mutex *right)
 {
-  while (true)
+  while (running.load(std::memory_order_relaxed))
     {
-      out.lock();
-      std::cout << "Philosopher " << n << " is thinking." << std::endl;
-      out.unlock();
+      out->log(n, thinking);
 
       left->lock();
-      out.lock();
-      std::cout << "Philosopher " << n << " picked up her left fork." << std::endl;
-      out.unlock();
+      out->log(n, picked_left);
 
       if (right->try_lock()) {
-        out.lock();
-        std::cout << "Philosopher " << n << " can pick right fork." << std::endl;
-        out.unlock();
+        out->log(n, can_pick_right);
       } else {
-        out.lock();
-        std::cout << "Philosopher " << n << " is putting down her left fork." << std::endl;
-        out.unlock();
+        out->log(n, putting_down_left);
         left->unlock();
+        continue; // she holds no fork, so she must not eat or put any down
       }
 
-      out.lock();
-      std::cout << "Philosopher " << n << " is eating." << std::endl;
-      out.unlock();
+      out->log(n, eating);
 
-      out.lock();
-      std::cout << "Philosopher " << n << " is putting down her right fork." << std::endl;
-      out.unlock();
+      out->log(n, putting_down_right);
       right->unlock();
 
-      out.lock();
-      std::cout << "Philosopher " << n << " is putting down her left fork." << std::endl;
-      out.unlock();
+      out->log(n, putting_down_left);
       left->unlock();
     }
 }
 
 void usage(char *program)
 {
-  std::cout << "Usage: " << program << " N  (where 2<=N<=10)" << std::endl;
+  std::cout << "Usage: " << program << " [-c] [-t SECONDS] N  (where 2<=N<=10)" << std::endl;
+  std::cout << "  -c  only count the events, print the totals once per second" << std::endl;
+  std::cout << "  -t  stop after SECONDS and print the event totals (default: run forever)" << std::endl;
   exit(1);
 }
 
 int main(int argc, char *argv[])
 {
-  if (argc != 2)
+  ring_logger::mode mode = ring_logger::print;
+  int seconds = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "ct:")) != -1)
+    {
+      switch (opt)
+        {
+        case 'c':
+          mode = ring_logger::counters;
+          break;
+        case 't':
+          seconds = atoi(optarg);
+          if (seconds < 1)
+            {
+              usage(argv[0]);
+            }
+          break;
+        default:
+          usage(argv[0]);
+        }
+    }
+  if (argc - optind != 1)
     {
       usage(argv[0]);
     }
 
-  // philosophers = argv[1]
+  // philosophers = argv[optind]
   int philosophers;
   try
     {
-      philosophers = std::stoi(argv[1]);
+      philosophers = std::stoi(argv[optind]);
     }
   catch (const std::exception&)
     {
@@ -72,6 +99,8 @@ int main(int argc, char *argv[])
       usage(argv[0]);
     }
 
+  out = new ring_logger(philosophers, event_messages, "Philosopher ", mode);
+
   // forks
   std::mutex *forks = new std::mutex[philosophers];
 
@@ -84,7 +113,20 @@ int main(int argc, char *argv[])
       ph[i] = std::thread(philosopher, i, &forks[left], &forks[right]);
     }
 
-  ph[0].join();
+  if (seconds == 0)
+    {
+      ph[0].join();
+    }
+  std::this_thread::sleep_for(std::chrono::seconds(seconds));
+  running = false;
+  for (int i=0; i<philosophers; ++i)
+    {
+      ph[i].join();
+    }
+  out->stop();
+  std::cout << "Totals after " << seconds << " seconds:" << std::endl;
+  out->report(std::cout);
+  delete out;
   delete[] forks;
   delete[] ph;
 
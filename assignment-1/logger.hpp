@@ -0,0 +1,220 @@
+#ifndef lacpp_logger_hpp
+#define lacpp_logger_hpp lacpp_logger_hpp
+
+/* buffered per-thread logging sink
+ *
+ * Every logging thread owns a single-producer/single-consumer ring of
+ * event numbers. log() only writes the event into the ring and bumps a
+ * counter owned by the same thread, so threads never wait for each other
+ * or for the terminal. A background thread drains all rings, formats the
+ * lines and writes them in batches with one flush per batch.
+ *
+ * Lines of one thread keep their order, lines of different threads are
+ * only ordered per batch. If a ring is full the event is counted but its
+ * line is dropped rather than stalling the thread; the number of dropped
+ * lines is printed when the logger is destroyed.
+ *
+ * In counters mode nothing goes through the rings at all; the drain
+ * thread prints the event totals once per second instead.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ring_logger
+{
+public:
+  enum mode { print, counters };
+
+  ring_logger(int threads, const std::vector<std::string>& messages,
+              const std::string& prefix, mode m = print,
+              std::ostream& os = std::cout, std::size_t capacity = 1 << 14)
+    : messages(messages), prefix(prefix), logging_mode(m), os(os),
+      capacity(capacity), producers(threads), stopping(false),
+      start(std::chrono::steady_clock::now())
+  {
+    for (auto& p : producers)
+      {
+        p.reset(new producer(capacity, messages.size()));
+      }
+    drain_thread = std::thread(&ring_logger::drain, this);
+  }
+
+  ring_logger(const ring_logger&) = delete;
+  ring_logger& operator=(const ring_logger&) = delete;
+
+  ~ring_logger()
+  {
+    stop();
+  }
+
+  /* drain what is left and stop the drain thread; the counters stay
+   * readable afterwards */
+  void stop()
+  {
+    if (!drain_thread.joinable())
+      {
+        return;
+      }
+    stopping.store(true, std::memory_order_release);
+    drain_thread.join();
+    drain_once();
+    unsigned long lost = 0;
+    for (auto& p : producers)
+      {
+        lost += p->dropped.load(std::memory_order_relaxed);
+      }
+    if (lost > 0)
+      {
+        os << lost << " log lines dropped (ring buffer full)" << std::endl;
+      }
+  }
+
+  /* called by thread `thread` only */
+  void log(int thread, int event)
+  {
+    producer& p = *producers[thread];
+    p.counts[event].store(p.counts[event].load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
+    if (logging_mode == counters)
+      {
+        return;
+      }
+    std::size_t head = p.head.load(std::memory_order_relaxed);
+    if (head - p.tail.load(std::memory_order_acquire) == capacity)
+      {
+        p.dropped.store(p.dropped.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+        return;
+      }
+    p.ring[head % capacity] = event;
+    p.head.store(head + 1, std::memory_order_release);
+  }
+
+  unsigned long count(int thread, int event) const
+  {
+    return producers[thread]->counts[event].load(std::memory_order_relaxed);
+  }
+
+  unsigned long total(int event) const
+  {
+    unsigned long sum = 0;
+    for (std::size_t i = 0; i < producers.size(); ++i)
+      {
+        sum += count(i, event);
+      }
+    return sum;
+  }
+
+  /* one line per event with its total over all threads */
+  void report(std::ostream& out) const
+  {
+    for (std::size_t e = 0; e < messages.size(); ++e)
+      {
+        out << "  " << messages[e] << ": " << total(e) << '\n';
+      }
+    out.flush();
+  }
+
+private:
+  struct producer
+  {
+    char padding_before[64];
+    std::atomic<std::size_t> head; // written by the logging thread
+    char padding_head[64];
+    std::atomic<std::size_t> tail; // written by the drain thread
+    char padding_tail[64];
+    std::unique_ptr<int[]> ring;
+    std::unique_ptr<std::atomic<unsigned long>[]> counts;
+    std::atomic<unsigned long> dropped;
+    char padding_after[64];
+
+    producer(std::size_t capacity, std::size_t events)
+      : head(0), tail(0), ring(new int[capacity]),
+        counts(new std::atomic<unsigned long>[events]), dropped(0)
+    {
+      for (std::size_t e = 0; e < events; ++e)
+        {
+          counts[e].store(0, std::memory_order_relaxed);
+        }
+    }
+  };
+
+  /* write everything that is in the rings now, returns the line count */
+  std::size_t drain_once()
+  {
+    std::string batch;
+    std::size_t lines = 0;
+    for (std::size_t i = 0; i < producers.size(); ++i)
+      {
+        producer& p = *producers[i];
+        std::size_t tail = p.tail.load(std::memory_order_relaxed);
+        std::size_t head = p.head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail, ++lines)
+          {
+            batch += prefix;
+            batch += std::to_string(i);
+            batch += ' ';
+            batch += messages[p.ring[tail % capacity]];
+            batch += '\n';
+          }
+        p.tail.store(tail, std::memory_order_release);
+      }
+    if (lines > 0)
+      {
+        os.write(batch.data(), batch.size());
+        os.flush();
+      }
+    return lines;
+  }
+
+  void drain()
+  {
+    auto next_summary = start + std::chrono::seconds(1);
+    while (!stopping.load(std::memory_order_acquire))
+      {
+        if (logging_mode == print)
+          {
+            if (drain_once() == 0)
+              {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+              }
+            continue;
+          }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_summary)
+          {
+            std::ostringstream line;
+            line << std::chrono::duration_cast<std::chrono::seconds>(now - start).count() << "s:";
+            for (std::size_t e = 0; e < messages.size(); ++e)
+              {
+                line << (e == 0 ? " " : ", ") << messages[e] << ' ' << total(e);
+              }
+            line << '\n';
+            os << line.str();
+            os.flush();
+            next_summary += std::chrono::seconds(1);
+          }
+      }
+  }
+
+  std::vector<std::string> messages;
+  std::string prefix;
+  mode logging_mode;
+  std::ostream& os;
+  std::size_t capacity;
+  std::vector<std::unique_ptr<producer>> producers;
+  std::atomic<bool> stopping;
+  std::chrono::steady_clock::time_point start;
+  std::thread drain_thread;
+};
+
+#endif // lacpp_logger_hpp
@@ -1,38 +1,45 @@
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <thread>
 #include <mutex>
+#include <unistd.h>
+
+#include "logger.hpp"
 
 using namespace std;
 
-std::mutex out;
+enum event { thinking, picked_left, picked_right, eating, putting_down_forks, dropping_left };
+
+const std::vector<std::string> event_messages = {
+  "is thinking.",
+  "picked up her left fork.",
+  "picked up her right fork.",
+  "is eating.",
+  "is putting down her forks",
+  "Could't get right fork so he is droping left",
+};
+
+ring_logger *out;
+std::atomic<bool> running(true);
 
 void philosopher(int n, std::mutex *left, std::mutex *right)
 {
-  while (true)
+  while (running.load(std::memory_order_relaxed))
     {
-      out.lock();
-      std::cout << "Philosopher " << n << " is thinking." << std::endl;
-      out.unlock();
+      out->log(n, thinking);
 
       left->lock();
-      out.lock();
-      std::cout << "Philosopher " << n << " picked up her left fork." << std::endl;
-      out.unlock();
+      out->log(n, picked_left);
       
       // try locking the right fork and if not posible drop the left one and wait so others can eat
       if(right->try_lock()){ 
-          out.lock();
-          std::cout << "Philosopher " << n << " picked up her right fork." << std::endl;
-          out.unlock();
+          out->log(n, picked_right);
           
           
-          out.lock();
-          std::cout << "Philosopher " << n << " is eating." << std::endl;
-          out.unlock();
+          out->log(n, eating);
 
-          out.lock();
-          std::cout << "Philosopher " << n << " is putting down her forks" << std::endl;
-          out.unlock();
+          out->log(n, putting_down_forks);
           right->unlock();
           left->unlock();
 
@@ -40,9 +47,7 @@ void philosopher(int n, std::mutex *left, std::mutex *right)
           this_thread::sleep_for(chrono::milliseconds(100)); 
 
       }else{
-          out.lock();
-          cout<<"Philosopher " << n << " Could't get right fork so he is droping left" << std::endl;
-          out.unlock();
+          out->log(n, dropping_left);
           left->unlock();
           // make the thread sleep for a bit when unable to eat and allow others to eat
           this_thread::sleep_for(chrono::milliseconds(200)); 
@@ -53,22 +58,45 @@ void philosopher(int n, std::mutex *left, std::mutex *right)
 
 void usage(char *program)
 {
-  std::cout << "Usage: " << program << " N  (where 2<=N<=10)" << std::endl;
+  std::cout << "Usage: " << program << " [-c] [-t SECONDS] N  (where 2<=N<=10)" << std::endl;
+  std::cout << "  -c  only count the events, print the totals once per second" << std::endl;
+  std::cout << "  -t  stop after SECONDS and print the event totals (default: run forever)" << std::endl;
   exit(1);
 }
 
 int main(int argc, char *argv[])
 {
-  if (argc != 2)
+  ring_logger::mode mode = ring_logger::print;
+  int seconds = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "ct:")) != -1)
+    {
+      switch (opt)
+        {
+        case 'c':
+          mode = ring_logger::counters;
+          break;
+        case 't':
+          seconds = atoi(optarg);
+          if (seconds < 1)
+            {
+              usage(argv[0]);
+            }
+          break;
+        default:
+          usage(argv[0]);
+        }
+    }
+  if (argc - optind != 1)
     {
       usage(argv[0]);
     }
 
-  // philosophers = argv[1]
+  // philosophers = argv[optind]
   int philosophers;
   try
     {
-      philosophers = std::stoi(argv[1]);
+      philosophers = std::stoi(argv[optind]);
     }
   catch (const std::exception&)
     {
@@ -79,6 +107,8 @@ int main(int argc, char *argv[])
       usage(argv[0]);
     }
 
+  out = new ring_logger(philosophers, event_messages, "Philosopher ", mode);
+
   // forks
   std::mutex *forks = new std::mutex[philosophers];
 
@@ -91,7 +121,20 @@ int main(int argc, char *argv[])
       ph[i] = std::thread(philosopher, i, &forks[left], &forks[right]);
     }
 
-  ph[0].join();
+  if (seconds == 0)
+    {
+      ph[0].join();
+    }
+  std::this_thread::sleep_for(std::chrono::seconds(seconds));
+  running = false;
+  for (int i=0; i<philosophers; ++i)
+    {
+      ph[i].join();
+    }
+  out->stop();
+  std::cout << "Totals after " << seconds << " seconds:" << std::endl;
+  out->report(std::cout);
+  delete out;
   delete[] forks;
   delete[] ph;
 
@@ -1,32 +1,845 @@
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <linux/perf_event.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+// keep a loop scalar even when the optimizer would vectorize it
+#if defined(__GNUC__) && !defined(__clang__)
+#define NO_VECTORIZE __attribute__((optimize("no-tree-vectorize")))
+#else
+#define NO_VECTORIZE
+#endif
+
+// default for -i
 const int iterations = 100;
 
-void loop(char *data, int size)
+void loop(char *data, std::size_t size, int iters)
 {
-  for (int i=0; i<iterations; ++i)
+  for (int i=0; i<iters; ++i)
     {
-      for (int j=0; j<size; ++j)
+      for (std::size_t j=0; j<size; ++j)
         {
           ++data[j];  // read and update data[j]
         }
     }
 }
 
+// explicit variants of loop(): every one adds `iters` to each byte of
+// data[0..size), they only differ in how many bytes one instruction updates
+
+NO_VECTORIZE
+void update_scalar(char *data, std::size_t size, int iters)
+{
+  for (int i=0; i<iters; ++i)
+    {
+      for (std::size_t j=0; j<size; ++j)
+        {
+          ++data[j];
+        }
+    }
+}
+
+// SWAR: eight byte adds in a 64-bit word, the top bit of every byte is
+// handled separately so carries never cross into the next byte
+NO_VECTORIZE
+void update_swar(char *data, std::size_t size, int iters)
+{
+  const std::uint64_t low7 = 0x7f7f7f7f7f7f7f7fULL;
+  const std::uint64_t ones = 0x0101010101010101ULL;
+  std::size_t words = size / 8;
+  for (int i=0; i<iters; ++i)
+    {
+      for (std::size_t j=0; j<words; ++j)
+        {
+          std::uint64_t x;
+          std::memcpy(&x, data + 8*j, 8);
+          x = ((x & low7) + ones) ^ (x & ~low7);
+          std::memcpy(data + 8*j, &x, 8);
+        }
+    }
+  update_scalar(data + 8*words, size - 8*words, iters);
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+void update_sse2(char *data, std::size_t size, int iters)
+{
+  const __m128i one = _mm_set1_epi8(1);
+  std::size_t vectors = size / 16;
+  for (int i=0; i<iters; ++i)
+    {
+      for (std::size_t j=0; j<vectors; ++j)
+        {
+          __m128i *p = (__m128i *)(data + 16*j);
+          _mm_storeu_si128(p, _mm_add_epi8(_mm_loadu_si128(p), one));
+        }
+    }
+  update_scalar(data + 16*vectors, size - 16*vectors, iters);
+}
+
+__attribute__((target("avx2")))
+void update_avx2(char *data, std::size_t size, int iters)
+{
+  const __m256i one = _mm256_set1_epi8(1);
+  std::size_t vectors = size / 32;
+  for (int i=0; i<iters; ++i)
+    {
+      for (std::size_t j=0; j<vectors; ++j)
+        {
+          __m256i *p = (__m256i *)(data + 32*j);
+          _mm256_storeu_si256(p, _mm256_add_epi8(_mm256_loadu_si256(p), one));
+        }
+    }
+  update_scalar(data + 32*vectors, size - 32*vectors, iters);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void update_avx512(char *data, std::size_t size, int iters)
+{
+  const __m512i one = _mm512_set1_epi8(1);
+  std::size_t vectors = size / 64;
+  for (int i=0; i<iters; ++i)
+    {
+      for (std::size_t j=0; j<vectors; ++j)
+        {
+          char *p = data + 64*j;
+          _mm512_storeu_si512(p, _mm512_add_epi8(_mm512_loadu_si512(p), one));
+        }
+    }
+  update_scalar(data + 64*vectors, size - 64*vectors, iters);
+}
+#endif
+
+typedef void (*update_function)(char *, std::size_t, int);
+
+struct UpdateVariant
+{
+  const char *name;
+  update_function function;
+  bool supported;
+};
+
+std::vector<UpdateVariant> update_variants()
+{
+  std::vector<UpdateVariant> variants;
+  variants.push_back({ "scalar", update_scalar, true });
+  variants.push_back({ "swar", update_swar, true });
+#ifdef HAVE_X86_SIMD
+  __builtin_cpu_init();
+  variants.push_back({ "sse2", update_sse2, (bool)__builtin_cpu_supports("sse2") });
+  variants.push_back({ "avx2", update_avx2, (bool)__builtin_cpu_supports("avx2") });
+  variants.push_back({ "avx512", update_avx512,
+        __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") });
+#endif
+  return variants;
+}
+
+// loop interchange: run all iterations on one cache-sized block before
+// moving on, so only the first pass over a block misses in the cache
+void update_blocked(update_function update, char *data, std::size_t size, int iters, std::size_t block)
+{
+  for (std::size_t offset=0; offset<size; offset+=block)
+    {
+      update(data + offset, std::min(block, size - offset), iters);
+    }
+}
+
+// false sharing experiment: thread `id` owns the granules id, id + threads,
+// id + 2*threads, ... of data[0..size), so with granules smaller than a
+// cache line several threads keep writing to the same line; scalar like
+// update_scalar so that only the ownership pattern differs between modes
+NO_VECTORIZE
+void update_interleaved(char *data, std::size_t size, std::size_t granule, int id, int threads, int iters)
+{
+  std::size_t step = granule * threads;
+  for (int i=0; i<iters; ++i)
+    {
+      for (std::size_t base=id*granule; base<size; base+=step)
+        {
+          std::size_t end = std::min(base + granule, size);
+          for (std::size_t j=base; j<end; ++j)
+            {
+              ++data[j];
+            }
+        }
+    }
+}
+
+// bandwidth kernels, each works on one thread's slice of n elements and
+// touches every stride-th element; sink keeps reads from being optimized away
+
+template <typename T>
+void read_kernel(const T *a, std::size_t n, std::size_t stride, int iters, T *sink)
+{
+  T sum = 0;
+  for (int i=0; i<iters; ++i)
+    {
+      for (std::size_t j=0; j<n; j+=stride)
+        {
+          sum += a[j];
+        }
+    }
+  *sink = sum;
+}
+
+template <typename T>
+void write_kernel(T *a, std::size_t n, std::size_t stride, int iters)
+{
+  for (int i=0; i<iters; ++i)
+    {
+      for (std::size_t j=0; j<n; j+=stride)
+        {
+          a[j] = (T)i;
+        }
+    }
+}
+
+template <typename T>
+void copy_kernel(T *a, const T *b, std::size_t n, std::size_t stride, int iters)
+{
+  for (int i=0; i<iters; ++i)
+    {
+      for (std::size_t j=0; j<n; j+=stride)
+        {
+          a[j] = b[j];
+        }
+    }
+}
+
+template <typename T>
+void triad_kernel(T *a, const T *b, const T *c, std::size_t n, std::size_t stride, int iters)
+{
+  const T scalar = 3;
+  for (int i=0; i<iters; ++i)
+    {
+      for (std::size_t j=0; j<n; j+=stride)
+        {
+          a[j] = b[j] + scalar * c[j];
+        }
+    }
+}
+
+template <typename T>
+void update_kernel(T *a, std::size_t n, std::size_t stride, int iters)
+{
+  for (int i=0; i<iters; ++i)
+    {
+      for (std::size_t j=0; j<n; j+=stride)
+        {
+          ++a[j];
+        }
+    }
+}
+
+// follow the cycle stored in next[] for `steps` loads; every load depends
+// on the previous one, so this measures latency rather than bandwidth
+void chase_kernel(const std::size_t *next, std::size_t start, std::size_t steps, std::size_t *sink)
+{
+  std::size_t p = start;
+  for (std::size_t s=0; s<steps; ++s)
+    {
+      p = next[p];
+    }
+  *sink = p;
+}
+
+// link the nodes at positions 0, stride, 2*stride, ... of next[0..n) into
+// one random cycle (Sattolo's algorithm), so the prefetcher cannot help
+void build_chase(std::size_t *next, std::size_t n, std::size_t stride, unsigned seed)
+{
+  std::size_t nodes = (n + stride - 1) / stride;
+  if (nodes == 0)
+    {
+      return;
+    }
+  std::vector<std::size_t> order(nodes);
+  for (std::size_t i=0; i<nodes; ++i)
+    {
+      order[i] = i * stride;
+    }
+  std::mt19937_64 engine(seed);
+  for (std::size_t i=nodes-1; i>0; --i)
+    {
+      std::uniform_int_distribution<std::size_t> pick(0, i-1);
+      std::swap(order[i], order[pick(engine)]);
+    }
+  for (std::size_t i=0; i<nodes; ++i)
+    {
+      next[order[i]] = order[(i+1) % nodes];
+    }
+}
+
+struct Options
+{
+  int threads;
+  std::size_t size;       // bytes per array
+  std::string kernel;
+  int width;              // element width in bytes
+  std::size_t stride;     // in elements
+  int iterations;
+  std::string pages;      // small, thp or hugetlb
+  std::string placement;  // main, first-touch or interleave
+  std::string schedule;   // static, cyclic or dynamic
+  std::size_t chunk;      // bytes per cyclic/dynamic block
+};
+
+// hand out the elements [0, n) to worker `id` as calls f(begin, end).
+// static: one contiguous slice per thread, the first n % threads threads
+// get one element more; cyclic: blocks of `chunk` elements dealt out
+// round-robin; dynamic: threads take the next block from *next.
+// Cyclic and dynamic blocks get all iterations before the next block.
+template <typename Function>
+void for_each_block(const Options &opt, std::size_t n, std::size_t chunk, int id,
+                    std::atomic<std::size_t> *next, Function f)
+{
+  if (opt.schedule == "static")
+    {
+      std::size_t begin = n * id / opt.threads;
+      std::size_t end = n * (id + 1) / opt.threads;
+      if (begin < end)
+        {
+          f(begin, end);
+        }
+    }
+  else if (opt.schedule == "cyclic")
+    {
+      for (std::size_t begin=id*chunk; begin<n; begin+=chunk*opt.threads)
+        {
+          f(begin, std::min(begin + chunk, n));
+        }
+    }
+  else
+    {
+      while (true)
+        {
+          std::size_t begin = next->fetch_add(chunk);
+          if (begin >= n)
+            {
+              break;
+            }
+          f(begin, std::min(begin + chunk, n));
+        }
+    }
+}
+
+// blocks a worker touches first: its own blocks, or its static slice
+// under the dynamic schedule where ownership is only known at run time
+template <typename Function>
+void for_each_owned_block(const Options &opt, std::size_t n, std::size_t chunk, int id, Function f)
+{
+  Options owner = opt;
+  if (owner.schedule == "dynamic")
+    {
+      owner.schedule = "static";
+    }
+  for_each_block(owner, n, chunk, id, nullptr, f);
+}
+
+// cyclic/dynamic block size in elements of `width` bytes, a multiple of
+// the stride so strided accesses keep their pattern across blocks
+std::size_t chunk_elements(const Options &opt, std::size_t width, std::size_t stride)
+{
+  std::size_t chunk = std::max<std::size_t>(1, opt.chunk / width);
+  return (chunk + stride - 1) / stride * stride;
+}
+
+// memory is mmap'ed and left untouched, so the first write decides on
+// which NUMA node a page lands; with placement main (new char[]() in the
+// original program) the main thread writes everything before the run
+
+std::size_t huge_page_size()
+{
+  std::ifstream meminfo("/proc/meminfo");
+  std::string key;
+  std::size_t kb;
+  while (meminfo >> key)
+    {
+      if (key == "Hugepagesize:" && meminfo >> kb)
+        {
+          return kb * 1024;
+        }
+    }
+  return 2 * 1024 * 1024;
+}
+
+std::size_t mapping_length(const Options &opt, std::size_t bytes)
+{
+  std::size_t page = opt.pages == "hugetlb" ? huge_page_size() : (std::size_t)sysconf(_SC_PAGESIZE);
+  return (bytes + page - 1) / page * page;
+}
+
+// spread the pages round-robin over all online NUMA nodes
+void interleave_pages(void *p, std::size_t length)
+{
+  std::ifstream online("/sys/devices/system/node/online");
+  std::string ranges;
+  online >> ranges;
+  std::vector<unsigned long> mask(16, 0);
+  const std::size_t bits = 8 * sizeof(unsigned long);
+  std::size_t pos = 0;
+  while (pos < ranges.size())
+    {
+      std::size_t end = ranges.find(',', pos);
+      std::string range = ranges.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+      std::size_t dash = range.find('-');
+      std::size_t first = std::stoul(range.substr(0, dash));
+      std::size_t last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+      for (std::size_t node=first; node<=last && node<mask.size()*bits; ++node)
+        {
+          mask[node / bits] |= 1UL << (node % bits);
+        }
+      pos = end == std::string::npos ? ranges.size() : end + 1;
+    }
+  if (ranges.empty())
+    {
+      mask[0] = 1;
+    }
+  if (syscall(SYS_mbind, p, length, MPOL_INTERLEAVE, mask.data(), mask.size() * bits, 0) != 0)
+    {
+      std::cerr << "warning: mbind(MPOL_INTERLEAVE) failed: " << std::strerror(errno) << std::endl;
+    }
+}
+
+char *allocate(const Options &opt, std::size_t bytes)
+{
+  std::size_t length = mapping_length(opt, bytes);
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  if (opt.pages == "hugetlb")
+    {
+      flags |= MAP_HUGETLB;
+    }
+  void *p = mmap(nullptr, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (p == MAP_FAILED)
+    {
+      std::cerr << "mmap of " << length << " bytes failed: " << std::strerror(errno) << std::endl;
+      if (opt.pages == "hugetlb")
+        {
+          std::cerr << "are enough huge pages reserved in /proc/sys/vm/nr_hugepages?" << std::endl;
+        }
+      exit(1);
+    }
+  if (opt.pages == "thp" && madvise(p, length, MADV_HUGEPAGE) != 0)
+    {
+      std::cerr << "warning: madvise(MADV_HUGEPAGE) failed: " << std::strerror(errno) << std::endl;
+    }
+  if (opt.placement == "interleave")
+    {
+      interleave_pages(p, length);
+    }
+  return (char *)p;
+}
+
+void deallocate(const Options &opt, void *p, std::size_t bytes)
+{
+  munmap(p, mapping_length(opt, bytes));
+}
+
+bool first_touch(const Options &opt)
+{
+  return opt.placement == "first-touch";
+}
+
+// zero the update loop data, on the main thread unless the workers
+// first-touch their own blocks in touch_owned
+void touch_main(const Options &opt, char *data)
+{
+  if (!first_touch(opt))
+    {
+      std::memset(data, 0, opt.size);
+    }
+}
+
+void touch_owned(const Options &opt, char *data, int id)
+{
+  if (first_touch(opt))
+    {
+      for_each_owned_block(opt, opt.size, chunk_elements(opt, 1, 1), id, [&](std::size_t begin, std::size_t end)
+        {
+          std::memset(data + begin, 0, end - begin);
+        });
+    }
+}
+
+// first-touch the granules update_interleaved gives to thread `id`, so
+// that under first-touch every thread writes pages it placed itself
+void touch_interleaved(const Options &opt, char *data, std::size_t granule, int id)
+{
+  if (first_touch(opt))
+    {
+      std::size_t step = granule * opt.threads;
+      for (std::size_t base=id*granule; base<opt.size; base+=step)
+        {
+          std::memset(data + base, 0, std::min(base + granule, opt.size) - base);
+        }
+    }
+}
+
+// per-thread dTLB load miss counter, reads -1 when perf events are not
+// available (e.g. perf_event_paranoid or a VM without a PMU)
+class TlbCounter
+{
+  int fd;
+
+public:
+  TlbCounter()
+  {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB
+      | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+      | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+  ~TlbCounter()
+  {
+    if (fd >= 0)
+      {
+        close(fd);
+      }
+  }
+  void start()
+  {
+    if (fd >= 0)
+      {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+  }
+  long long stop()
+  {
+    long long count;
+    if (fd < 0)
+      {
+        return -1;
+      }
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) != sizeof(count))
+      {
+        return -1;
+      }
+    return count;
+  }
+};
+
+// dTLB load misses of the last timed_parallel run, -1 if not measured
+long long tlb_misses = -1;
+
+// start all threads, let each run setup(i) (e.g. first-touch of its slice),
+// release them together and time until the last one finishes; thread
+// creation and setup are not timed
+template <typename Setup, typename Function>
+double timed_parallel(int threads, Setup setup, Function body)
+{
+  std::atomic<int> ready(0);
+  std::atomic<bool> go(false);
+  std::atomic<long long> misses(0);
+  std::atomic<bool> counted(true);
+  std::thread *t = new std::thread[threads];
+  for (int i=0; i<threads; ++i)
+    {
+      t[i] = std::thread([&, i]()
+        {
+          TlbCounter counter;
+          setup(i);
+          ++ready;
+          while (!go.load(std::memory_order_acquire))
+            {
+              std::this_thread::yield();
+            }
+          counter.start();
+          body(i);
+          long long count = counter.stop();
+          if (count < 0)
+            counted = false;
+          else
+            misses += count;
+        });
+    }
+  while (ready.load() < threads)
+    {
+      std::this_thread::yield();
+    }
+
+  // *** timing begins here ***
+  auto start_time = std::chrono::steady_clock::now();
+  go.store(true, std::memory_order_release);
+  for (int i=0; i<threads; ++i)
+    {
+      t[i].join();
+    }
+  std::chrono::duration<double> duration =
+    (std::chrono::steady_clock::now() - start_time);
+  // *** timing ends here ***
+
+  tlb_misses = counted ? misses.load() : -1;
+  delete[] t;
+  return duration.count();
+}
+
+template <typename Function>
+double timed_parallel(int threads, Function body)
+{
+  return timed_parallel(threads, [](int) {}, body);
+}
+
+std::string tlb_report()
+{
+  if (tlb_misses < 0)
+    {
+      return "";
+    }
+  return ", " + std::to_string(tlb_misses) + " dTLB load misses";
+}
+
+void report(const std::string &kernel, double seconds, double bytes)
+{
+  std::cout << kernel << ": " << seconds << " seconds, "
+            << bytes / seconds / 1e9 << " GB/s" << tlb_report() << std::endl;
+}
+
+// run one bandwidth kernel on arrays of T, setup happens outside the timing
+template <typename T>
+void run_bandwidth(const Options &opt, const std::string &kernel)
+{
+  std::size_t n = opt.size / sizeof(T);
+  int arrays = kernel == "triad" ? 3 : (kernel == "copy" ? 2 : 1);
+  std::vector<T*> data(3, nullptr);
+  std::size_t chunk = chunk_elements(opt, sizeof(T), opt.stride);
+  for (int k=0; k<arrays; ++k)
+    {
+      data[k] = (T *)allocate(opt, n * sizeof(T));
+      if (!first_touch(opt))
+        std::memset(data[k], k + 1, n * sizeof(T));
+    }
+  T *a = data[0], *b = data[1], *c = data[2];
+
+  std::vector<T> sinks(opt.threads);
+  std::vector<std::size_t> touched(opt.threads, 0);
+  std::atomic<std::size_t> next(0);
+
+  auto setup = [&](int id)
+    {
+      for (int k=0; first_touch(opt) && k<arrays; ++k)
+        {
+          for_each_owned_block(opt, n, chunk, id, [&](std::size_t begin, std::size_t end)
+            {
+              std::memset(data[k] + begin, k + 1, (end - begin) * sizeof(T));
+            });
+        }
+    };
+  double seconds = timed_parallel(opt.threads, setup, [&](int id)
+    {
+      for_each_block(opt, n, chunk, id, &next, [&](std::size_t begin, std::size_t end)
+        {
+          std::size_t len = end - begin;
+          if (kernel == "read")
+            read_kernel(a + begin, len, opt.stride, opt.iterations, &sinks[id]);
+          else if (kernel == "write")
+            write_kernel(a + begin, len, opt.stride, opt.iterations);
+          else if (kernel == "copy")
+            copy_kernel(a + begin, b + begin, len, opt.stride, opt.iterations);
+          else if (kernel == "triad")
+            triad_kernel(a + begin, b + begin, c + begin, len, opt.stride, opt.iterations);
+          else
+            update_kernel(a + begin, len, opt.stride, opt.iterations);
+          touched[id] += (len + opt.stride - 1) / opt.stride;
+        });
+    });
+
+  // bytes the kernel asks for, not counting write-allocate traffic
+  int streams = kernel == "triad" ? 3 : (kernel == "copy" || kernel == "update" ? 2 : 1);
+  double elements = 0;
+  for (std::size_t t : touched)
+    {
+      elements += t;
+    }
+  double bytes = elements * opt.iterations * sizeof(T) * streams;
+  report(kernel, seconds, bytes);
+
+  for (int k=0; k<arrays; ++k)
+    {
+      deallocate(opt, data[k], n * sizeof(T));
+    }
+}
+
+void run_chase(const Options &opt)
+{
+  // every thread chases a cycle through its own static slice, whatever
+  // the schedule, since the cycle is a single dependent chain
+  std::size_t n = opt.size / sizeof(std::size_t);
+  std::size_t *next = (std::size_t *)allocate(opt, n * sizeof(std::size_t));
+  auto begin = [&](int id) { return n * id / opt.threads; };
+  auto length = [&](int id) { return begin(id + 1) - begin(id); };
+  for (int t=0; !first_touch(opt) && t<opt.threads; ++t)
+    {
+      build_chase(next + begin(t), length(t), opt.stride, t + 1);
+    }
+  std::vector<std::size_t> sinks(opt.threads);
+
+  auto setup = [&](int id)
+    {
+      if (first_touch(opt))
+        build_chase(next + begin(id), length(id), opt.stride, id + 1);
+    };
+  auto steps = [&](int id)
+    {
+      return ((length(id) + opt.stride - 1) / opt.stride) * opt.iterations;
+    };
+  double seconds = timed_parallel(opt.threads, setup, [&](int id)
+    {
+      chase_kernel(next + begin(id), 0, steps(id), &sinks[id]);
+    });
+
+  // threads run concurrently, so latency is time per load of one chain
+  double accesses = 0;
+  for (int t=0; t<opt.threads; ++t)
+    {
+      accesses += steps(t);
+    }
+  std::cout << "chase: " << seconds << " seconds, "
+            << seconds * 1e9 * opt.threads / accesses << " ns per dependent load, "
+            << accesses * sizeof(std::size_t) / seconds / 1e9 << " GB/s" << tlb_report() << std::endl;
+  deallocate(opt, next, n * sizeof(std::size_t));
+}
+
+void run(const Options &opt, const std::string &kernel)
+{
+  if (kernel == "chase")
+    {
+      run_chase(opt);
+      return;
+    }
+  switch (opt.width)
+    {
+    case 1: run_bandwidth<std::uint8_t>(opt, kernel); break;
+    case 2: run_bandwidth<std::uint16_t>(opt, kernel); break;
+    case 4: run_bandwidth<std::uint32_t>(opt, kernel); break;
+    default: run_bandwidth<std::uint64_t>(opt, kernel); break;
+    }
+}
+
 void usage(char *program)
 {
-  std::cout << "Usage: " << program << " T N" << std::endl;
+  std::cout << "Usage: " << program << " [options] T N" << std::endl;
   std::cout << std::endl;
   std::cout << "  T: number of threads" << std::endl;
   std::cout << "  N: array size in MB" << std::endl;
+  std::cout << std::endl;
+  std::cout << "Without options the original byte update loop is timed." << std::endl;
+  std::cout << std::endl;
+  std::cout << "  -k KERNEL  update, read, write, copy, triad, chase or all" << std::endl;
+  std::cout << "  -w WIDTH   element width in bytes: 1, 2, 4 or 8 (default 1)" << std::endl;
+  std::cout << "  -s STRIDE  touch every STRIDE-th element (default 1)" << std::endl;
+  std::cout << "  -i ITERS   passes over the array (default 100)" << std::endl;
+  std::cout << "  -v VARIANT byte update loop variant: scalar, swar, sse2, avx2," << std::endl;
+  std::cout << "             avx512 or all" << std::endl;
+  std::cout << "  -b KB      with -v, also time the variant with all iterations" << std::endl;
+  std::cout << "             run on one KB sized block at a time" << std::endl;
+  std::cout << "  -f BYTES   update loop with threads owning interleaved BYTES sized" << std::endl;
+  std::cout << "             granules (false sharing below the cache line size);" << std::endl;
+  std::cout << "             'all' compares 1, 8, 64 bytes, a page and contiguous slices" << std::endl;
+  std::cout << "  -a PAGES   small (default), thp (madvise MADV_HUGEPAGE) or hugetlb" << std::endl;
+  std::cout << "             (MAP_HUGETLB, needs reserved huge pages)" << std::endl;
+  std::cout << "  -p PLACE   who first touches the pages: main (default), first-touch" << std::endl;
+  std::cout << "             (each worker its own blocks) or interleave (all NUMA nodes)" << std::endl;
+  std::cout << "  -S SCHED   static (default, one slice per thread), cyclic (blocks dealt" << std::endl;
+  std::cout << "             round-robin) or dynamic (threads take the next free block)" << std::endl;
+  std::cout << "  -c BYTES   block size for cyclic and dynamic (default 1048576)" << std::endl;
   exit(1);
 }
 
 int main(int argc, char *argv[])
 {
-  if (argc != 3)
+  Options opt;
+  opt.width = 1;
+  opt.stride = 1;
+  opt.iterations = iterations;
+  opt.pages = "small";
+  opt.placement = "main";
+  opt.schedule = "static";
+  opt.chunk = 1 << 20;
+  std::string variant;
+  std::size_t block_kb = 0;
+  std::string granule_option;
+
+  int c;
+  try
+    {
+      while ((c = getopt(argc, argv, "k:w:s:i:v:b:f:a:p:S:c:")) != -1)
+        {
+          switch (c)
+            {
+            case 'k': opt.kernel = optarg; break;
+            case 'v': variant = optarg; break;
+            case 'b': block_kb = std::stoul(optarg); break;
+            case 'f': granule_option = optarg; break;
+            case 'a': opt.pages = optarg; break;
+            case 'p': opt.placement = optarg; break;
+            case 'S': opt.schedule = optarg; break;
+            case 'c': opt.chunk = std::stoull(optarg); break;
+            case 'w': opt.width = std::stoi(optarg); break;
+            case 's': opt.stride = std::stoul(optarg); break;
+            case 'i': opt.iterations = std::stoi(optarg); break;
+            default: usage(argv[0]);
+            }
+        }
+    }
+  catch (const std::exception&)
+    {
+      usage(argv[0]);
+    }
+  if (opt.width != 1 && opt.width != 2 && opt.width != 4 && opt.width != 8)
+    {
+      usage(argv[0]);
+    }
+  if (opt.stride < 1 || opt.iterations < 1)
+    {
+      usage(argv[0]);
+    }
+  if (opt.pages != "small" && opt.pages != "thp" && opt.pages != "hugetlb")
+    {
+      usage(argv[0]);
+    }
+  if (opt.placement != "main" && opt.placement != "first-touch" && opt.placement != "interleave")
+    {
+      usage(argv[0]);
+    }
+  if ((opt.schedule != "static" && opt.schedule != "cyclic" && opt.schedule != "dynamic") || opt.chunk < 1)
+    {
+      usage(argv[0]);
+    }
+  if (!opt.kernel.empty() && opt.kernel != "update" && opt.kernel != "read"
+      && opt.kernel != "write" && opt.kernel != "copy" && opt.kernel != "triad"
+      && opt.kernel != "chase" && opt.kernel != "all")
+    {
+      usage(argv[0]);
+    }
+
+  if (argc - optind != 2)
     {
       usage(argv[0]);
     }
@@ -35,7 +848,7 @@ int main(int argc, char *argv[])
   int threads;
   try
     {
-      threads = std::stoi(argv[1]);
+      threads = std::stoi(argv[optind]);
     }
   catch (const std::exception&)
     {
@@ -47,10 +860,10 @@ int main(int argc, char *argv[])
     }
 
   // size = argv[2]
-  int size;
+  long long size;
   try
     {
-      size = std::stoi(argv[2]);
+      size = std::stoll(argv[optind + 1]);
     }
   catch (const std::exception&)
     {
@@ -61,35 +874,163 @@ int main(int argc, char *argv[])
       usage(argv[0]);
     }
 
-  // *** timing begins here ***
-  auto start_time = std::chrono::system_clock::now();
+  opt.threads = threads;
+  opt.size = (std::size_t)size * 1024 * 1024; // convert size from MB to bytes
 
-  // allocate and initialize data[]
-  size *= 1024 * 1024; // convert size from MB to bytes
-  char *data = new char[size]();
+  if (!granule_option.empty())
+    {
+      // 0 stands for contiguous per-thread slices, the layout of loop()
+      std::vector<std::size_t> granules;
+      if (granule_option == "all")
+        {
+          granules = { 1, 8, 64, (std::size_t)sysconf(_SC_PAGESIZE), 0 };
+        }
+      else
+        {
+          try
+            {
+              granules.push_back(std::stoul(granule_option));
+            }
+          catch (const std::exception&)
+            {
+              usage(argv[0]);
+            }
+          if (granules[0] < 1)
+            {
+              usage(argv[0]);
+            }
+        }
 
-  // create and join threads
-  std::thread *t = new std::thread[threads];
-  int size_per_thread = size / threads;
-  char *thread_data = data;
-  for (int i=0; i<threads; ++i)
+      std::cout << "threads " << opt.threads << ", " << size << " MB, "
+                << opt.iterations << " iterations" << std::endl;
+      for (std::size_t granule : granules)
+        {
+          // fresh pages for every mode, first-touch places them only once
+          char *data = allocate(opt, opt.size);
+          touch_main(opt, data);
+          auto setup = [&](int id)
+            {
+              if (granule == 0)
+                touch_owned(opt, data, id);
+              else
+                touch_interleaved(opt, data, granule, id);
+            };
+          std::atomic<std::size_t> next(0);
+          double seconds = timed_parallel(opt.threads, setup, [&](int id)
+            {
+              if (granule == 0)
+                for_each_block(opt, opt.size, opt.chunk, id, &next, [&](std::size_t begin, std::size_t end)
+                  {
+                    update_scalar(data + begin, end - begin, opt.iterations);
+                  });
+              else
+                update_interleaved(data, opt.size, granule, id, opt.threads, opt.iterations);
+            });
+          std::string mode = granule == 0 ? "contiguous " + opt.schedule
+            : "interleaved " + std::to_string(granule) + " B";
+          report(mode, seconds, 2.0 * opt.size * opt.iterations);
+          deallocate(opt, data, opt.size);
+        }
+      return 0;
+    }
+
+  if (!variant.empty())
     {
-      t[i] = std::thread(loop, thread_data, size_per_thread);
-      thread_data += size_per_thread;
+      std::vector<UpdateVariant> variants = update_variants();
+      bool found = variant == "all";
+      for (const UpdateVariant &v : variants)
+        {
+          found = found || variant == v.name;
+        }
+      if (!found)
+        {
+          usage(argv[0]);
+        }
+
+      char *data = allocate(opt, opt.size);
+      touch_main(opt, data);
+      auto setup = [&](int id) { touch_owned(opt, data, id); };
+      std::size_t block = block_kb * 1024;
+      double bytes = 2.0 * opt.size * opt.iterations;
+      std::cout << "threads " << opt.threads << ", " << size << " MB, "
+                << opt.iterations << " iterations" << std::endl;
+      for (const UpdateVariant &v : variants)
+        {
+          if (variant != "all" && variant != v.name)
+            {
+              continue;
+            }
+          if (!v.supported)
+            {
+              std::cout << v.name << ": not supported by this CPU" << std::endl;
+              continue;
+            }
+          std::atomic<std::size_t> next(0);
+          double seconds = timed_parallel(opt.threads, setup, [&](int id)
+            {
+              for_each_block(opt, opt.size, opt.chunk, id, &next, [&](std::size_t begin, std::size_t end)
+                {
+                  v.function(data + begin, end - begin, opt.iterations);
+                });
+            });
+          report(v.name, seconds, bytes);
+          if (block > 0)
+            {
+              next = 0;
+              seconds = timed_parallel(opt.threads, [&](int id)
+                {
+                  for_each_block(opt, opt.size, opt.chunk, id, &next, [&](std::size_t begin, std::size_t end)
+                    {
+                      update_blocked(v.function, data + begin, end - begin, opt.iterations, block);
+                    });
+                });
+              report(std::string(v.name) + " blocked " + std::to_string(block_kb) + " KB", seconds, bytes);
+            }
+        }
+      deallocate(opt, data, opt.size);
+      return 0;
     }
 
-  for (int i=0; i<threads; ++i)
+  if (!opt.kernel.empty())
     {
-      t[i].join();
+      std::cout << "threads " << opt.threads << ", " << size << " MB per array, "
+                << opt.width << "-byte elements, stride " << opt.stride
+                << ", " << opt.iterations << " iterations, " << opt.schedule << " schedule" << std::endl;
+      if (opt.kernel == "all")
+        {
+          const char *kernels[] = { "read", "write", "copy", "triad", "update", "chase" };
+          for (const char *k : kernels)
+            {
+              run(opt, k);
+            }
+        }
+      else
+        {
+          run(opt, opt.kernel);
+        }
+      return 0;
     }
 
-  delete[] data;
+  // allocate and initialize data[]
+  char *data = allocate(opt, opt.size);
+  touch_main(opt, data);
 
-  std::chrono::duration<double> duration =
-    (std::chrono::system_clock::now() - start_time);
-  // *** timing ends here ***
+  // create and join threads
+  std::atomic<std::size_t> next(0);
+  double seconds = timed_parallel(threads, [&](int i)
+    {
+      touch_owned(opt, data, i);
+    }, [&](int i)
+    {
+      for_each_block(opt, opt.size, opt.chunk, i, &next, [&](std::size_t begin, std::size_t end)
+        {
+          loop(data + begin, end - begin, opt.iterations);
+        });
+    });
+
+  deallocate(opt, data, opt.size);
 
-  std::cout << "Finished in " << duration.count() << " seconds (wall clock)." << std::endl;
+  std::cout << "Finished in " << seconds << " seconds (wall clock)" << tlb_report() << "." << std::endl;
 
   return 0;
 }
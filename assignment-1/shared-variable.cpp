@@ -1,64 +1,350 @@
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <iomanip>
 #include <thread>
 #include <mutex>
 #include <chrono>
+#include <string>
+#include <vector>
+#include <sched.h>
+#include <unistd.h>
 
-std::mutex mutex;
+#include "../assignment2/stop_signal.hpp"
 
-long x = 0;
-bool run = true;
+/*
+ * Shared counter benchmark.
+ *
+ * T threads increment one logical counter as fast as they can while a
+ * reader thread samples it. The counter is implemented as
+ *   mutex        a long protected by a std::mutex (the original program)
+ *   atomic       one std::atomic<long> updated with fetch_add
+ *   sharded      one cache line padded slot per thread, reads add them up
+ *   approximate  one slot per CPU, folded into a global value whenever a
+ *                slot reaches the fold threshold; reads only look at the
+ *                global value, so they lag by about the threshold
+ *                per CPU
+ *
+ * Staleness is how far a read is behind the increments that had been done
+ * when it returned. To know that number every thread also publishes its
+ * own increment count in a padded slot of its own; this costs the same
+ * uncontended store for every counter kind. Increments done while the
+ * reader adds up those slots count as stale too, so even the exact
+ * counters can show a small staleness on a busy machine.
+ *
+ * Incrementing threads look at the stop signal only every -n increments;
+ * -n 1 puts the check back on every iteration for comparison.
+ */
 
-void inc()
+// padded to the same cache line size as the stop signal
+struct padded_long
 {
-  bool r = true;
-  while (r)
-    {
-      mutex.lock();
-      ++x;
-      r = run;
-      mutex.unlock();
-    }
+  std::atomic<long> value;
+  char padding[STOP_SIGNAL_CACHE_LINE - sizeof(std::atomic<long>)];
+
+  padded_long() : value(0) {}
+  padded_long(const padded_long&) : value(0) {}
+};
+
+class mutex_counter
+{
+public:
+  explicit mutex_counter(int) : x(0) {}
+
+  void add(int)
+  {
+    mutex.lock();
+    ++x;
+    mutex.unlock();
+  }
+
+  long read()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return x;
+  }
+
+private:
+  std::mutex mutex;
+  long x;
+};
+
+class atomic_counter
+{
+public:
+  explicit atomic_counter(int) : x(0) {}
+
+  void add(int)
+  {
+    x.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  long read()
+  {
+    return x.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<long> x;
+};
+
+/* only the owning thread writes its slot, so a plain load and store is
+ * enough and the line never moves while nobody reads */
+class sharded_counter
+{
+public:
+  explicit sharded_counter(int threads) : slots(threads) {}
+
+  void add(int thread)
+  {
+    std::atomic<long>& slot = slots[thread].value;
+    slot.store(slot.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  long read()
+  {
+    long sum = 0;
+    for (auto& s : slots)
+      {
+        sum += s.value.load(std::memory_order_relaxed);
+      }
+    return sum;
+  }
+
+private:
+  std::vector<padded_long> slots;
+};
+
+/* threads on the same CPU share a slot, so slots need atomic updates, but
+ * they are only contended when the scheduler migrates a thread */
+class approximate_counter
+{
+public:
+  approximate_counter(int, long fold)
+    : fold(fold), global(0), slots(std::max(1L, sysconf(_SC_NPROCESSORS_CONF))) {}
+
+  void add(int)
+  {
+    int cpu = sched_getcpu();
+    std::atomic<long>& slot = slots[cpu < 0 ? 0 : cpu % slots.size()].value;
+    if (slot.fetch_add(1, std::memory_order_relaxed) + 1 >= fold)
+      {
+        global.fetch_add(slot.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+      }
+  }
+
+  long read()
+  {
+    return global.load(std::memory_order_relaxed);
+  }
+
+  /* exact value, for the final check */
+  long total()
+  {
+    long sum = global.load();
+    for (auto& s : slots)
+      {
+        sum += s.value.load();
+      }
+    return sum;
+  }
+
+private:
+  long fold;
+  std::atomic<long> global;
+  std::vector<padded_long> slots;
+};
+
+struct options
+{
+  std::string kind = "all";
+  int threads = 2;
+  int seconds = 1;
+  long fold = 1024;
+  int read_interval_us = 100;
+  unsigned stop_interval = 64;
+};
+
+template<typename Counter>
+long exact_total(Counter& counter)
+{
+  return counter.read();
 }
 
-void dec()
+long exact_total(approximate_counter& counter)
 {
-  bool r = true;
-  while (r)
-    {
-      mutex.lock();
-      --x;
-      r = run;
-      mutex.unlock();
-    }
+  return counter.total();
 }
 
-void print()
+template<typename Counter>
+void run(const std::string& name, Counter& counter, const options& opt)
 {
-  bool r = true;
-  while (r)
+  stop_signal stop;
+  std::vector<padded_long> progress(opt.threads);
+
+  auto inc = [&](int id, stop_signal::token token)
+    {
+      std::atomic<long>& done = progress[id].value;
+      long n = 0;
+      while (!token.stop_requested())
+        {
+          counter.add(id);
+          done.store(++n, std::memory_order_relaxed);
+        }
+    };
+
+  long samples = 0;
+  double staleness_sum = 0.0;
+  long staleness_max = 0;
+  auto reader = [&](stop_signal::token token)
     {
-      mutex.lock();
-      std::cout << x << std::endl;
-      r = run;
-      mutex.unlock();
+      while (!token.stop_requested())
+        {
+          long value = counter.read();
+          long done = 0;
+          for (auto& p : progress)
+            {
+              done += p.value.load(std::memory_order_relaxed);
+            }
+          /* progress is read after the counter, so a thread may be counted
+           * one increment ahead; never report negative staleness */
+          long behind = std::max(0L, done - value);
+          staleness_sum += behind;
+          staleness_max = std::max(staleness_max, behind);
+          samples++;
+          std::this_thread::sleep_for(std::chrono::microseconds(opt.read_interval_us));
+        }
+    };
+
+  std::vector<std::thread> incs;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < opt.threads; ++i)
+    {
+      incs.push_back(std::thread(inc, i, stop.get_token(opt.stop_interval)));
+    }
+  std::thread print(reader, stop.get_token(1));
+
+  std::this_thread::sleep_for(std::chrono::seconds(opt.seconds));
+  stop.request_stop();
+
+  for (auto& t : incs)
+    {
+      t.join();
+    }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  print.join();
+
+  long increments = 0;
+  for (auto& p : progress)
+    {
+      increments += p.value.load();
     }
+  long value = exact_total(counter);
+
+  std::cout << std::setw(12) << name
+            << std::setw(16) << std::fixed << std::setprecision(0) << increments / elapsed
+            << std::setw(12) << samples
+            << std::setw(16) << std::setprecision(1) << (samples ? staleness_sum / samples : 0.0)
+            << std::setw(14) << staleness_max
+            << (value == increments ? "" : "  WRONG TOTAL") << std::endl;
 }
 
-int main(int argc, char *argv[], char* envp[])
+void usage(char *program)
 {
-  std::thread t1(inc);
-  std::thread t2(dec);
-  std::thread t3(print);
+  std::cout << "Usage: " << program << " [-k KIND] [-t THREADS] [-s SECONDS] [-f FOLD] [-r US] [-n N]" << std::endl;
+  std::cout << "  -k  mutex, atomic, sharded, approximate or all (default all)" << std::endl;
+  std::cout << "  -t  incrementing threads (default 2)" << std::endl;
+  std::cout << "  -s  seconds per counter kind (default 1)" << std::endl;
+  std::cout << "  -f  fold threshold of the approximate counter (default 1024)" << std::endl;
+  std::cout << "  -r  microseconds between reads of the reader thread (default 100)" << std::endl;
+  std::cout << "  -n  increments between checks of the stop signal (default 64)" << std::endl;
+  exit(1);
+}
 
-  std::this_thread::sleep_for(std::chrono::seconds(1));
+long read_number(char *program, const char *text, long min)
+{
+  long value = 0;
+  try
+    {
+      value = std::stol(text);
+    }
+  catch (const std::exception&)
+    {
+      usage(program);
+    }
+  if (value < min)
+    {
+      usage(program);
+    }
+  return value;
+}
 
-  mutex.lock();
-  run = false;
-  mutex.unlock();
+int main(int argc, char *argv[])
+{
+  options opt;
+  int c;
+  while ((c = getopt(argc, argv, "k:t:s:f:r:n:")) != -1)
+    {
+      switch (c)
+        {
+        case 'k':
+          opt.kind = optarg;
+          if (opt.kind != "mutex" && opt.kind != "atomic" && opt.kind != "sharded"
+              && opt.kind != "approximate" && opt.kind != "all")
+            {
+              usage(argv[0]);
+            }
+          break;
+        case 't':
+          opt.threads = read_number(argv[0], optarg, 1);
+          break;
+        case 's':
+          opt.seconds = read_number(argv[0], optarg, 1);
+          break;
+        case 'f':
+          opt.fold = read_number(argv[0], optarg, 1);
+          break;
+        case 'r':
+          opt.read_interval_us = read_number(argv[0], optarg, 0);
+          break;
+        case 'n':
+          opt.stop_interval = read_number(argv[0], optarg, 1);
+          break;
+        default:
+          usage(argv[0]);
+        }
+    }
+  if (optind != argc)
+    {
+      usage(argv[0]);
+    }
 
-  t1.join();
-  t2.join();
-  t3.join();
+  std::cout << opt.threads << " threads, " << opt.seconds << " s per counter, stop checked every "
+            << opt.stop_interval << " increments, staleness in increments" << std::endl;
+  std::cout << std::setw(12) << "counter" << std::setw(16) << "increments/s"
+            << std::setw(12) << "reads" << std::setw(16) << "mean stale"
+            << std::setw(14) << "max stale" << std::endl;
+  bool all = opt.kind == "all";
+  if (all || opt.kind == "mutex")
+    {
+      mutex_counter counter(opt.threads);
+      run("mutex", counter, opt);
+    }
+  if (all || opt.kind == "atomic")
+    {
+      atomic_counter counter(opt.threads);
+      run("atomic", counter, opt);
+    }
+  if (all || opt.kind == "sharded")
+    {
+      sharded_counter counter(opt.threads);
+      run("sharded", counter, opt);
+    }
+  if (all || opt.kind == "approximate")
+    {
+      approximate_counter counter(opt.threads, opt.fold);
+      run("approximate", counter, opt);
+    }
 
   return 0;
 }
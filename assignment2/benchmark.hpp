@@ -11,14 +11,18 @@
 #include <thread>
 #include <vector>
 
+#include "stop_signal.hpp"
+
 enum class worker_status {wait, work, finish};
 
 static const int RANDOM_VALUE_RANGE_MIN = 0;
 static const int RANDOM_VALUE_RANGE_MAX = 65536;
+/* operations between two checks for the end of the run */
+static const unsigned STOP_CHECK_INTERVAL = 64;
 
 /* template is used to allow functions/functors of any signature */
 template<typename Function>
-void worker(unsigned int random_seed, double& ops_per_sec, std::atomic<worker_status>* status, Function fun) {
+void worker(unsigned int random_seed, double& ops_per_sec, std::atomic<worker_status>* status, stop_signal::token stop, Function fun) {
 	/* set up random number generator */
 	std::mt19937 engine(random_seed);
 	std::uniform_int_distribution<int> uniform_dist(RANDOM_VALUE_RANGE_MIN, RANDOM_VALUE_RANGE_MAX);
@@ -28,7 +32,9 @@ void worker(unsigned int random_seed, double& ops_per_sec, std::atomic<worker_st
 	while(*status == worker_status::wait);
 	std::chrono::time_point<clock> start_time = clock::now();
 	long items = 0;
-	while(*status == worker_status::work) {
+	/* status is only polled until the start, the end of the run is seen
+	 * through the stop token so no shared load sits on the hot path */
+	while(!stop.stop_requested()) {
 		auto random = uniform_dist(engine);
 		/* do specified work */
 		fun(random);
@@ -47,6 +53,7 @@ void benchmark(int threadcnt, std::string identifier, Function fun) {
 	/* initialize worker status */
 	std::atomic<worker_status> status;
 	status = worker_status::wait;
+	stop_signal stop;
 
 	/* spawn workers */
 	std::vector<double> ops_per_second(threadcnt);
@@ -55,13 +62,15 @@ void benchmark(int threadcnt, std::string identifier, Function fun) {
 	for(int i = 0; i < threadcnt; i++) {
 		auto seed = rd();
 		auto& result = ops_per_second[i];
-		auto w = new std::thread([seed, &result, &status, fun]() { worker(seed, result, &status, fun); });
+		auto token = stop.get_token(STOP_CHECK_INTERVAL);
+		auto w = new std::thread([seed, &result, &status, token, fun]() { worker(seed, result, &status, token, fun); });
 		workers.push_back(w);
 	};
 
 	/* start work for 5s */
 	status = worker_status::work;
 	std::this_thread::sleep_for(std::chrono::seconds(5));
+	stop.request_stop();
 	status = worker_status::finish;
 
 	/* make sure all workers terminated */
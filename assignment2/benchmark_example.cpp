@@ -3,6 +3,7 @@
 #include <random>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "benchmark.hpp"
 #if defined(USE_1)
@@ -15,6 +16,16 @@
 #include "ex4_04.hpp"
 #elif defined(USE_5)
 #include "ex4_05(notWorking).hpp"
+#elif defined(USE_6)
+#include "ex4_06.hpp"
+#elif defined(USE_7)
+#include "ex4_07.hpp"
+#elif defined(USE_8)
+#include "ex4_08.hpp"
+#elif defined(USE_9)
+#include "ex4_09.hpp"
+#elif defined(USE_10)
+#include "ex4_10.hpp"
 #else
 #include "ex4_01.hpp"
 #endif
@@ -22,11 +33,18 @@
 static const int DATA_VALUE_RANGE_MIN = 0;
 static const int DATA_VALUE_RANGE_MAX = 256;
 static const int DATA_PREFILL = 512;
+/* keys handled by one batch operation */
+static const int BATCH_SIZE = 32;
+/* all reads store their counts here, so the compiler cannot drop the
+ * traversals of counts whose result is otherwise unused */
+static volatile std::size_t read_sink;
+/* width of the key ranges read by the scan benchmarks */
+static const int SCAN_WIDTH = 16;
 
 template<typename List>
 void read(List& l, int random) {
 	/* read operations: 100% count */
-	l.count(random % DATA_VALUE_RANGE_MAX);
+	read_sink = l.count(random % DATA_VALUE_RANGE_MAX);
 }
 
 template<typename List>
@@ -49,10 +67,104 @@ void mixed(List& l, int random) {
 	} else if(choice == 1) {
 		l.remove(random % DATA_VALUE_RANGE_MAX);
 	} else {
-		l.count(random % DATA_VALUE_RANGE_MAX);
+		read_sink = l.count(random % DATA_VALUE_RANGE_MAX);
 	}
 }
 
+/* derive BATCH_SIZE keys from one random number */
+std::vector<int> batch_keys(int random) {
+	std::vector<int> keys(BATCH_SIZE);
+	unsigned int state = random;
+	for(auto& k : keys) {
+		state = state * 1664525u + 1013904223u;
+		k = (state >> 8) % DATA_VALUE_RANGE_MAX;
+	}
+	return keys;
+}
+
+template<typename List>
+void batch_read(List& l, int random) {
+	/* read operations: count of BATCH_SIZE keys in one traversal */
+	std::size_t sum = 0;
+	for(auto c : l.count_batch(batch_keys(random))) {
+		sum += c;
+	}
+	read_sink = sum;
+}
+
+template<typename List>
+void batch_update(List& l, int random) {
+	/* update operations: 50% insert batch, 50% remove batch */
+	auto choice = (random % (2*DATA_VALUE_RANGE_MAX))/DATA_VALUE_RANGE_MAX;
+	if(choice == 0) {
+		l.insert_batch(batch_keys(random));
+	} else {
+		l.remove_batch(batch_keys(random));
+	}
+}
+
+template<typename List>
+void keywise_read(List& l, int random) {
+	/* the keys of batch_read, counted one at a time */
+	std::size_t sum = 0;
+	for(int k : batch_keys(random)) {
+		sum += l.count(k);
+	}
+	read_sink = sum;
+}
+
+template<typename List>
+void keywise_update(List& l, int random) {
+	/* the keys of batch_update, inserted or removed one at a time */
+	auto choice = (random % (2*DATA_VALUE_RANGE_MAX))/DATA_VALUE_RANGE_MAX;
+	for(int k : batch_keys(random)) {
+		if(choice == 0) {
+			l.insert(k);
+		} else {
+			l.remove(k);
+		}
+	}
+}
+
+template<typename List>
+void scan(List& l, int random) {
+	/* scan operations: 6.25% update, 93.75% count_range */
+	auto choice = (random % (32*DATA_VALUE_RANGE_MAX))/DATA_VALUE_RANGE_MAX;
+	auto lo = random % DATA_VALUE_RANGE_MAX;
+	if(choice == 0) {
+		l.insert(lo);
+	} else if(choice == 1) {
+		l.remove(lo);
+	} else {
+		read_sink = l.count_range(lo, lo + SCAN_WIDTH);
+	}
+}
+
+template<typename List>
+void snapshot_scan(List& l, int random) {
+	/* scan operations: 6.25% update, 93.75% snapshot */
+	auto choice = (random % (32*DATA_VALUE_RANGE_MAX))/DATA_VALUE_RANGE_MAX;
+	auto lo = random % DATA_VALUE_RANGE_MAX;
+	if(choice == 0) {
+		l.insert(lo);
+	} else if(choice == 1) {
+		l.remove(lo);
+	} else {
+		read_sink = l.snapshot(lo, lo + SCAN_WIDTH).size();
+	}
+}
+
+/* variants that keep statistics print them after every benchmark,
+ * build with -DINSTRUMENT_LOCKS for the lock statistics of ex4_01 to ex4_04 */
+template<typename List>
+auto report_statistics(List& l, int) -> decltype(l.report_statistics(std::cout), void()) {
+	l.report_statistics(std::cout);
+}
+
+template<typename List>
+void report_statistics(List&, long) {
+}
+
 int main(int argc, char* argv[]) {
 	/* get number of threads from command line */
 	if(argc < 2) {
@@ -80,9 +192,11 @@ int main(int argc, char* argv[]) {
 		benchmark(threadcnt, u8"non-thread-safe read", [&l1](int random){
 			read(l1, random);
 		});
+		report_statistics(l1, 0);
 		benchmark(threadcnt, u8"non-thread-safe update", [&l1](int random){
 			update(l1, random);
 		});
+		report_statistics(l1, 0);
 	}
 	{
 		/* start with fresh list: update test left list in random size */
@@ -94,6 +208,47 @@ int main(int argc, char* argv[]) {
 		benchmark(threadcnt, u8"non-thread-safe mixed", [&l1](int random){
 			mixed(l1, random);
 		});
+		report_statistics(l1, 0);
+	}
+	{
+		/* batches against the same keys one at a time, both report
+		 * operations of BATCH_SIZE keys */
+		std::string keys = u8" (" + std::to_string(BATCH_SIZE) + u8" keys per operation)";
+		sorted_list<int> l1;
+		for(int i = 0; i < DATA_PREFILL; i++) {
+			l1.insert(uniform_dist(engine));
+		}
+		benchmark(threadcnt, u8"keywise read" + keys, [&l1](int random){
+			keywise_read(l1, random);
+		});
+		report_statistics(l1, 0);
+		benchmark(threadcnt, u8"batch read" + keys, [&l1](int random){
+			batch_read(l1, random);
+		});
+		report_statistics(l1, 0);
+		benchmark(threadcnt, u8"keywise update" + keys, [&l1](int random){
+			keywise_update(l1, random);
+		});
+		report_statistics(l1, 0);
+		benchmark(threadcnt, u8"batch update" + keys, [&l1](int random){
+			batch_update(l1, random);
+		});
+		report_statistics(l1, 0);
+	}
+	{
+		/* scan-heavy mixes, ranges of SCAN_WIDTH keys */
+		sorted_list<int> l1;
+		for(int i = 0; i < DATA_PREFILL; i++) {
+			l1.insert(uniform_dist(engine));
+		}
+		benchmark(threadcnt, u8"scan mixed (count_range)", [&l1](int random){
+			scan(l1, random);
+		});
+		report_statistics(l1, 0);
+		benchmark(threadcnt, u8"scan mixed (snapshot)", [&l1](int random){
+			snapshot_scan(l1, random);
+		});
+		report_statistics(l1, 0);
 	}
 	return EXIT_SUCCESS;
 }
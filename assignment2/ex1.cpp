@@ -1,26 +1,49 @@
 #include <iostream>
 #include <string>
-#include <pthread.h>
 #include <cmath>
 #include <chrono>
 #include <cstdlib>
+#include <algorithm>
+
+#include "integration.hpp"
+#include "thread_pool.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EX1_HAVE_X86_SIMD 1
+#endif
 
 using namespace std;
 
-struct ThreadArgs {
-    int start_index;
-    int count;
-    long double x_step;
-    long double* total_area;
-    pthread_mutex_t* mutex;
+// long double: original x87 path, double: vectorized single-evaluation path
+enum class Kernel { LongDouble, Double };
+
+// static: one contiguous block per thread, dynamic: threads grab chunks
+// of chunk_size trapezoids from a shared counter
+struct Schedule {
+    bool dynamic;
+    long long chunk_size;
 };
-    
+
 void usage(char *program) {
-    cout << "Parallel Trapezoidal Integration using POSIX threads\n\n";
-    cout << "Usage: " << program << " <number_of_threads> <number_of_trapezoids>\n";
+    cout << "Parallel Trapezoidal Integration using a persistent thread pool\n\n";
+    cout << "Usage: " << program << " <number_of_threads> <number_of_trapezoids> [options]\n";
     cout << "Example: " << program << " 4 1000\n\n";
     cout << "Options:\n";
-    cout << "  -h, --help    Show this help message\n";
+    cout << "  --kernel=NAME  longdouble (default), double or compare\n";
+    cout << "                 double evaluates every sample point once using SIMD\n";
+    cout << "                 and compensated summation, compare runs both\n";
+    cout << "  --rule=NAME    integrate with the generic engine using trapezoid,\n";
+    cout << "                 simpson or gauss panels (number_of_trapezoids panels)\n";
+    cout << "  --tolerance=E  subdivide adaptively until the estimated error is below E\n";
+    cout << "                 (number_of_trapezoids is then ignored)\n";
+    cout << "  --schedule=S   static (default, one block per thread) or dynamic\n";
+    cout << "                 (threads take chunks from a shared counter)\n";
+    cout << "  --chunk=N      trapezoids per chunk for the dynamic schedule, raised\n";
+    cout << "                 if there would be more than 2^20 chunks\n";
+    cout << "  --repeat=N     run the integration N times on the same threads and\n";
+    cout << "                 report the mean time per run\n";
+    cout << "  -h, --help     Show this help message\n";
     exit(0);
 }
 
@@ -28,90 +51,339 @@ long double f(long double x) {
     return 4.0L / (1.0L + x*x);
 }
 
-void* calculate_range(void* arguments) {
-    ThreadArgs* args = (ThreadArgs*)arguments;
+double f(double x) {
+    return 4.0 / (1.0 + x*x);
+}
+
+// original kernel: two evaluations of f per trapezoid in long double
+long double trapezoid_sum_long_double(long long start_index, long long count, long double x_step) {
     long double local_sum = 0.0L;
 
-    for (int i = 0; i < args->count; i++) {
-        long double x1 = (args->start_index + i) * args->x_step;
-        long double x2 = x1 + args->x_step;
-        long double area = (args->x_step) * (f(x1) + f(x2)) / 2.0L;
+    for (long long i = 0; i < count; i++) {
+        long double x1 = (start_index + i) * x_step;
+        long double x2 = x1 + x_step;
+        long double area = x_step * (f(x1) + f(x2)) / 2.0L;
         local_sum += area;
     }
+    return local_sum;
+}
+
+// Kahan summation step, shared by the scalar loop and the lane reduction
+inline void kahan_add(double& sum, double& comp, double y) {
+    double t = y - comp;
+    double s = sum + t;
+    comp = (s - sum) - t;
+    sum = s;
+}
+
+// sum of f(i * x_step) for i in [first, first + n), scalar fallback
+double interior_sum_scalar(long long first, long long n, double x_step) {
+    double sum = 0.0, comp = 0.0;
+    for (long long i = 0; i < n; i++) {
+        kahan_add(sum, comp, f((first + i) * x_step));
+    }
+    return sum;
+}
+
+#ifdef EX1_HAVE_X86_SIMD
+// one Kahan accumulator per lane, the lanes are folded with Kahan afterwards
+__attribute__((target("avx2")))
+double interior_sum_avx2(long long first, long long n, double x_step) {
+    const __m256d step = _mm256_set1_pd(x_step);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d four = _mm256_set1_pd(4.0);
+    const __m256d lane_step = _mm256_set1_pd(4.0);
+    __m256d index = _mm256_setr_pd(first, first + 1, first + 2, first + 3);
+    __m256d sum = _mm256_setzero_pd();
+    __m256d comp = _mm256_setzero_pd();
+
+    long long i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_mul_pd(index, step);
+        __m256d y = _mm256_div_pd(four, _mm256_add_pd(one, _mm256_mul_pd(x, x)));
+        __m256d t = _mm256_sub_pd(y, comp);
+        __m256d s = _mm256_add_pd(sum, t);
+        comp = _mm256_sub_pd(_mm256_sub_pd(s, sum), t);
+        sum = s;
+        index = _mm256_add_pd(index, lane_step);
+    }
+
+    double sums[4], comps[4];
+    _mm256_storeu_pd(sums, sum);
+    _mm256_storeu_pd(comps, comp);
+    double total = 0.0, total_comp = 0.0;
+    for (int lane = 0; lane < 4; lane++) {
+        kahan_add(total, total_comp, sums[lane]);
+        kahan_add(total, total_comp, -comps[lane]);
+    }
+    kahan_add(total, total_comp, interior_sum_scalar(first + i, n - i, x_step));
+    return total;
+}
+
+__attribute__((target("avx512f")))
+double interior_sum_avx512(long long first, long long n, double x_step) {
+    const __m512d step = _mm512_set1_pd(x_step);
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d four = _mm512_set1_pd(4.0);
+    const __m512d lane_step = _mm512_set1_pd(8.0);
+    __m512d index = _mm512_setr_pd(first, first + 1, first + 2, first + 3,
+                                   first + 4, first + 5, first + 6, first + 7);
+    __m512d sum = _mm512_setzero_pd();
+    __m512d comp = _mm512_setzero_pd();
+
+    long long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d x = _mm512_mul_pd(index, step);
+        __m512d y = _mm512_div_pd(four, _mm512_add_pd(one, _mm512_mul_pd(x, x)));
+        __m512d t = _mm512_sub_pd(y, comp);
+        __m512d s = _mm512_add_pd(sum, t);
+        comp = _mm512_sub_pd(_mm512_sub_pd(s, sum), t);
+        sum = s;
+        index = _mm512_add_pd(index, lane_step);
+    }
+
+    double sums[8], comps[8];
+    _mm512_storeu_pd(sums, sum);
+    _mm512_storeu_pd(comps, comp);
+    double total = 0.0, total_comp = 0.0;
+    for (int lane = 0; lane < 8; lane++) {
+        kahan_add(total, total_comp, sums[lane]);
+        kahan_add(total, total_comp, -comps[lane]);
+    }
+    kahan_add(total, total_comp, interior_sum_scalar(first + i, n - i, x_step));
+    return total;
+}
+#endif
+
+double interior_sum(long long first, long long n, double x_step) {
+#ifdef EX1_HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx512f")) {
+        return interior_sum_avx512(first, n, x_step);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return interior_sum_avx2(first, n, x_step);
+    }
+#endif
+    return interior_sum_scalar(first, n, x_step);
+}
+
+// vectorized kernel: interior points are shared by two trapezoids, so the
+// range [a, b] is step * (f(a)/2 + f(x_1) + ... + f(x_n-1) + f(b)/2)
+long double trapezoid_sum_double(long long start_index, long long count, double x_step) {
+    if (count < 1) {
+        return 0.0L;
+    }
+    double edges = 0.5 * (f(start_index * x_step) + f((start_index + count) * x_step));
+    double sum = edges, comp = 0.0;
+    kahan_add(sum, comp, interior_sum(start_index + 1, count - 1, x_step));
+    return x_step * sum;
+}
+
+long double range_sum(Kernel kernel, long long start_index, long long count, long double x_step) {
+    if (kernel == Kernel::Double) {
+        return trapezoid_sum_double(start_index, count, (double)x_step);
+    }
+    return trapezoid_sum_long_double(start_index, count, x_step);
+}
+
+// integrate f over [0, 1] with the given kernel `repetitions` times on the
+// pool, returns the area and the mean kernel time per repetition
+long double integrate(thread_pool& pool, long long trapezoids, Kernel kernel, Schedule schedule,
+                      int repetitions, double& seconds) {
+    long double x_step = 1.0L / trapezoids;
+    long long chunk = schedule.dynamic ? schedule.chunk_size : 0;
+    long double total_area = 0.0L;
+
+    auto start_time = chrono::steady_clock::now();
+
+    for (int r = 0; r < repetitions; ++r) {
+        // fixed summation order: static results are reproducible for a given
+        // thread count, dynamic results for a given chunk size
+        total_area = pool.parallel_reduce<long double>(0, trapezoids, chunk,
+            [=](long long first, long long last) {
+                return range_sum(kernel, first, last - first, x_step);
+            });
+    }
+
+    auto duration = chrono::steady_clock::now() - start_time;
+    seconds = chrono::duration<double>(duration).count() / repetitions;
+
+    return total_area;
+}
+
+const char* kernel_name(Kernel kernel) {
+    return kernel == Kernel::Double ? "double" : "longdouble";
+}
 
-    pthread_mutex_lock(args->mutex);
-    *(args->total_area) += local_sum;
-    pthread_mutex_unlock(args->mutex);
+void report(const string& method, long double total_area, double seconds) {
+    static const long double pi = 3.141592653589793238462643383279502884L;
+    cout.precision(15);
+    cout << "Calculated value: " << total_area << " in " << seconds << " secs (wall clock)." << endl;
+    cout.precision(3);
+    cout << "  " << method << ", absolute error vs pi: "
+         << scientific << fabsl(total_area - pi) << defaultfloat << endl;
+}
 
-    return nullptr;
+void report(Kernel kernel, long double total_area, double seconds) {
+    report(string("kernel ") + kernel_name(kernel), total_area, seconds);
+}
+
+// run the generic engine on f over [0, 1]
+template<typename Rule>
+void run_engine(const string& rule, thread_pool& pool, long long panels, long double tolerance, int repetitions) {
+    auto integrand = [](long double x) { return f(x); };
+    auto start_time = chrono::steady_clock::now();
+    long double total_area = 0.0L;
+    integration::adaptive_stats stats;
+    for (int r = 0; r < repetitions; ++r) {
+        if (tolerance > 0.0L) {
+            total_area = integration::integrate_adaptive<Rule>(integrand, 0.0L, 1.0L, tolerance, pool, &stats);
+        } else {
+            total_area = integration::integrate<Rule>(integrand, 0.0L, 1.0L, panels, pool);
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count() / repetitions;
+
+    if (tolerance > 0.0L) {
+        report("adaptive " + rule, total_area, seconds);
+        cout << "  " << stats.intervals << " panels refined, " << stats.accepted
+             << " accepted, max depth " << stats.depth;
+        if (stats.unconverged > 0) {
+            cout << ", " << stats.unconverged << " hit the depth limit";
+        }
+        cout << endl;
+    } else {
+        report("rule " + rule, total_area, seconds);
+    }
 }
 
 int main(int argc, char* argv[]) {
-    if (argc == 2) {
-        string arg = argv[1];
+    string kernel_option = "longdouble";
+    string rule_option;
+    string tolerance_option;
+    string schedule_option = "static";
+    string chunk_option;
+    string repeat_option;
+    int positional = 0;
+    char* values[2];
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
         if (arg == "-h" || arg == "--help") {
             usage(argv[0]);
+        } else if (arg.compare(0, 9, "--kernel=") == 0) {
+            kernel_option = arg.substr(9);
+        } else if (arg.compare(0, 7, "--rule=") == 0) {
+            rule_option = arg.substr(7);
+        } else if (arg.compare(0, 12, "--tolerance=") == 0) {
+            tolerance_option = arg.substr(12);
+        } else if (arg.compare(0, 11, "--schedule=") == 0) {
+            schedule_option = arg.substr(11);
+        } else if (arg.compare(0, 8, "--chunk=") == 0) {
+            chunk_option = arg.substr(8);
+        } else if (arg.compare(0, 9, "--repeat=") == 0) {
+            repeat_option = arg.substr(9);
+        } else if (positional < 2) {
+            values[positional++] = argv[i];
+        } else {
+            usage(argv[0]);
         }
     }
 
-    if (argc != 3) {
+    if (positional != 2) {
         usage(argv[0]);
     }
 
-    int threads, trapezoids;
-
-    try {
-        threads = stoi(argv[1]);
-        trapezoids = stoi(argv[2]);
-    } catch (...) {
+    if (kernel_option != "longdouble" && kernel_option != "double" && kernel_option != "compare") {
         usage(argv[0]);
     }
 
-    if (threads < 1 || trapezoids < 1) {
+    if (schedule_option != "static" && schedule_option != "dynamic") {
         usage(argv[0]);
     }
 
-    long double x_step = 1.0L / trapezoids;
-    int trapezoids_per_thread = trapezoids / threads;
-    int remainder = trapezoids % threads;
-
-    pthread_t* thread_ids = new pthread_t[threads];
-    ThreadArgs* thread_args = new ThreadArgs[threads];
-    pthread_mutex_t total_area_mutex;
-    pthread_mutex_init(&total_area_mutex, nullptr);
-
-    long double total_area = 0.0L;
-    int current_start = 0;
-
-    auto start_time = chrono::system_clock::now();
+    int threads;
+    long long trapezoids;
+    long double tolerance = 0.0L;
+    int repetitions = 1;
+    Schedule schedule = { schedule_option == "dynamic", 0 };
 
-    for (int i = 0; i < threads; ++i) {
-        int count = trapezoids_per_thread + (i < remainder ? 1 : 0);
+    try {
+        threads = stoi(values[0]);
+        trapezoids = stoll(values[1]);
+        if (!tolerance_option.empty()) {
+            tolerance = stold(tolerance_option);
+        }
+        if (!chunk_option.empty()) {
+            schedule.chunk_size = stoll(chunk_option);
+        }
+        if (!repeat_option.empty()) {
+            repetitions = stoi(repeat_option);
+        }
+    } catch (...) {
+        usage(argv[0]);
+    }
 
-        thread_args[i].start_index = current_start;
-        thread_args[i].count = count;
-        thread_args[i].x_step = x_step;
-        thread_args[i].total_area = &total_area;
-        thread_args[i].mutex = &total_area_mutex;
+    if (threads < 1 || trapezoids < 1 || repetitions < 1 || (!tolerance_option.empty() && !(tolerance > 0.0L))) {
+        usage(argv[0]);
+    }
 
-        pthread_create(&thread_ids[i], nullptr, calculate_range, (void*)&thread_args[i]);
+    // the static schedule has no chunks
+    if (!chunk_option.empty() && (schedule.chunk_size < 1 || !schedule.dynamic)) {
+        usage(argv[0]);
+    }
+    if (schedule.chunk_size == 0) {
+        // about 16 chunks per thread, but never more than 2^20 trapezoids each
+        schedule.chunk_size = max(1LL, min(1LL << 20, trapezoids / (16LL * threads)));
+    }
+    if (schedule.dynamic && thread_pool::reduce_chunk(trapezoids, schedule.chunk_size) != schedule.chunk_size) {
+        // parallel_reduce would raise it anyway, say so instead of doing it silently
+        schedule.chunk_size = thread_pool::reduce_chunk(trapezoids, schedule.chunk_size);
+        cout << "Chunk size raised to " << schedule.chunk_size << " trapezoids to keep at most "
+             << POOL_MAX_CHUNKS << " chunks." << endl;
+    }
 
-        current_start += count;
+    if (!rule_option.empty() && rule_option != "trapezoid" && rule_option != "simpson" && rule_option != "gauss") {
+        usage(argv[0]);
     }
 
-    for (int i = 0; i < threads; ++i) {
-        pthread_join(thread_ids[i], nullptr);
+    // thread creation is paid once here instead of inside every timed run
+    auto pool_start = chrono::steady_clock::now();
+    thread_pool pool(threads);
+    double pool_seconds = chrono::duration<double>(chrono::steady_clock::now() - pool_start).count();
+    cout << "Thread pool startup: " << pool_seconds << " secs for " << threads << " threads." << endl;
+    if (repetitions > 1) {
+        cout << "Kernel times below are the mean of " << repetitions << " runs." << endl;
     }
 
-    auto duration = chrono::system_clock::now() - start_time;
+    if (!rule_option.empty() || tolerance > 0.0L) {
+        if (rule_option.empty() || rule_option == "trapezoid") {
+            run_engine<integration::trapezoid>("trapezoid", pool, trapezoids, tolerance, repetitions);
+        } else if (rule_option == "simpson") {
+            run_engine<integration::simpson>("simpson", pool, trapezoids, tolerance, repetitions);
+        } else {
+            run_engine<integration::gauss_legendre>("gauss", pool, trapezoids, tolerance, repetitions);
+        }
+        return 0;
+    }
 
-    pthread_mutex_destroy(&total_area_mutex);
+    double seconds;
+    if (kernel_option == "compare") {
+        long double reference = integrate(pool, trapezoids, Kernel::LongDouble, schedule, repetitions, seconds);
+        report(Kernel::LongDouble, reference, seconds);
+        double reference_seconds = seconds;
 
-    cout.precision(15);
-    cout << "Calculated value: " << total_area << " in " << chrono::duration<double>(duration).count() << " secs (wall clock)." << endl;
+        long double vectorized = integrate(pool, trapezoids, Kernel::Double, schedule, repetitions, seconds);
+        report(Kernel::Double, vectorized, seconds);
 
-    delete[] thread_ids;
-    delete[] thread_args;
+        cout.precision(3);
+        cout << "Speedup of double over longdouble: " << reference_seconds / seconds
+             << "x, difference: " << scientific << fabsl(vectorized - reference) << endl;
+    } else {
+        Kernel kernel = kernel_option == "double" ? Kernel::Double : Kernel::LongDouble;
+        long double total_area = integrate(pool, trapezoids, kernel, schedule, repetitions, seconds);
+        report(kernel, total_area, seconds);
+    }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,10 +1,12 @@
 #include <iostream>
 #include <cstdlib>
 #include <string>
-#include <pthread.h>
 #include <cmath>
 #include <vector>
 #include <chrono> 
+#include <algorithm>
+
+#include "thread_pool.hpp"
 
 using namespace std;
 
@@ -35,20 +37,15 @@ vector<long long> sequential_sieve(long long limit) {
     return primes;
 }
 
-struct ThreadArgs {
-    long long start;
-    long long end;
-    const vector<long long>* seed_primes; // list of seed primes
-    vector<bool>* is_prime_global;       // shared answer array
-};
+// numbers per sieving task; a multiple of 64 so that no two tasks ever
+// write bits of the same vector<bool> word, and small enough to stay in cache
+static const long long SEGMENT_SIZE = 1 << 18;
 
-// Parallelized function to find multiples
-void* thread_sieve(void* arg) {
-    ThreadArgs* args = static_cast<ThreadArgs*>(arg);
-    
-    for (long long p : *args->seed_primes) {
+// Parallelized function to find multiples in [start, end]
+void sieve_range(long long start, long long end, const vector<long long>& seed_primes, vector<bool>& is_prime_global) {
+    for (long long p : seed_primes) {
         // Find the first multiple of p
-        long long start_multiple = (args->start + p - 1) / p;
+        long long start_multiple = (start + p - 1) / p;
         long long start_idx = start_multiple * p;
 
         if (start_idx < p * p) {
@@ -56,29 +53,78 @@ void* thread_sieve(void* arg) {
         }
         
         // Mark the multiples 
-        for (long long j = start_idx; j <= args->end; j += p) {
-            (*args->is_prime_global)[j] = false;
+        for (long long j = start_idx; j <= end; j += p) {
+            is_prime_global[j] = false;
+        }
+    }
+}
+
+// one complete run: seed primes, parallel sieve and parallel count
+long long count_primes(thread_pool& pool, long long max_value, bool verbose) {
+    //  Sequentialy compute all primes to sqrt max
+    long long sequential_limit = static_cast<long long>(sqrt(max_value));
+    vector<long long> seed_primes = sequential_sieve(sequential_limit);
+    if (verbose) {
+        cout << "Computing primes up to sqrt(Max) = " << sequential_limit << endl;
+        cout << "Found " << seed_primes.size() << " seed primes." << endl;
+    }
+
+    // Shared array for all thrds
+    vector<bool> is_prime_global(max_value + 1, true);
+    is_prime_global[0] = is_prime_global[1] = false;
+
+    for (long long p : seed_primes) {
+        for (long long i = p * p; i <= sequential_limit; i += p) {
+            is_prime_global[i] = false;
         }
     }
 
-    delete args; 
-    return nullptr;
+    long long start_range = sequential_limit + 1;
+    long long end_range = max_value;
+    if (verbose) {
+        cout << "Parallel sieving from " << start_range << " to " << end_range << endl;
+    }
+
+    // tasks are whole segments counted from 0, so their boundaries stay word aligned
+    long long first_segment = start_range / SEGMENT_SIZE;
+    long long last_segment = end_range / SEGMENT_SIZE + 1;
+    pool.parallel_for(first_segment, last_segment, 1, [&](long long first, long long last, int) {
+        for (long long segment = first; segment < last; ++segment) {
+            long long chunk_start = max(start_range, segment * SEGMENT_SIZE);
+            long long chunk_end = min(end_range, (segment + 1) * SEGMENT_SIZE - 1);
+            sieve_range(chunk_start, chunk_end, seed_primes, is_prime_global);
+        }
+    });
+
+    return pool.parallel_reduce<long long>(2, max_value + 1, 0, [&](long long first, long long last) {
+        long long prime_count = 0;
+        for (long long i = first; i < last; ++i) {
+            if (is_prime_global[i]) {
+                prime_count++;
+            }
+        }
+        return prime_count;
+    });
 }
 
 
 int main(int argc, char* argv[]) {
     // Argument validation
-    if (argc != 3) {
-        cerr << "Usage: " << argv[0] << " <Max_value> <Num_threads>" << endl;
+    if (argc != 3 && argc != 4) {
+        cerr << "Usage: " << argv[0] << " <Max_value> <Num_threads> [Repetitions]" << endl;
         return 1; 
     }
 
     long long max_value;
     int num_threads;
+    int repetitions = 1;
 
     try {
         max_value = stoll(argv[1]);
         num_threads = stoi(argv[2]);
+        if (argc == 4) {
+            repetitions = stoi(argv[3]);
+        }
     } catch (const invalid_argument& ia) {
         cerr << "Invalid argument: " << ia.what() << endl;
         return 1;
@@ -87,73 +133,25 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    if (max_value < 2 || num_threads < 1) {
-        cerr << "Max value must be at least 2 and threads must be at least 1." << endl;
+    if (max_value < 2 || num_threads < 1 || repetitions < 1) {
+        cerr << "Max value must be at least 2, threads and repetitions must be at least 1." << endl;
         return 1;
     }
 
     cout << "Max value: " << max_value << endl;
     cout << "Number of threads: " << num_threads << endl;
 
-    // start timer
-    auto start_time = ::chrono::high_resolution_clock::now();
-
-    //  Sequentialy compute all primes to sqrt max
-    long long sequential_limit = static_cast<long long>(sqrt(max_value));
-    cout << "Computing primes up to sqrt(Max) = " << sequential_limit << endl;
-    vector<long long> seed_primes = sequential_sieve(sequential_limit);
-    cout << "Found " << seed_primes.size() << " seed primes." << endl;
-
-    // Shared array for all thrds
-    vector<bool> is_prime_global(max_value + 1, true);
-    is_prime_global[0] = is_prime_global[1] = false;
-
-    for (long long p : seed_primes) {
-        for (long long i = p * p; i <= sequential_limit; i += p) {
-            is_prime_global[i] = false;
-        }
-    }
-
-    // Create thread and divide work into chunks
-    vector<pthread_t> threads(num_threads);
-    long long start_range = sequential_limit + 1;
-    long long end_range = max_value;
-    long long chunk_size = (end_range - start_range + 1) / num_threads;
-    
-    cout << "Parallel sieving from " << start_range << " to " << end_range << endl;
-
-    for (int i = 0; i < num_threads; ++i) {
-        long long chunk_start = start_range + i * chunk_size;
-        long long chunk_end = (i == num_threads - 1) ? end_range : chunk_start + chunk_size - 1;
-
-        ThreadArgs* args = new ThreadArgs{
-            chunk_start,
-            chunk_end,
-            &seed_primes,
-            &is_prime_global
-        };
-        
-        // Thread creation
-        int result = pthread_create(&threads[i], nullptr, thread_sieve, static_cast<void*>(args));
-        if (result != 0) {
-            cerr << "Error creating thread " << i << endl;
-            delete args; 
-            return 1;
-        }
-    }
+    // threads are created once and reused by every run
+    auto pool_start = chrono::high_resolution_clock::now();
+    thread_pool pool(num_threads);
+    chrono::duration<double> pool_elapsed = chrono::high_resolution_clock::now() - pool_start;
 
-    //  Wait and process answers of threads
-    for (int i = 0; i < num_threads; ++i) {
-        pthread_join(threads[i], nullptr);
-    }
-    
-    
+    // start timer
+    auto start_time = chrono::high_resolution_clock::now();
 
     long long prime_count = 0;
-    for (long long i = 2; i <= max_value; ++i) {
-        if (is_prime_global[i]) {
-            prime_count++;
-        }
+    for (int r = 0; r < repetitions; ++r) {
+        prime_count = count_primes(pool, max_value, r == 0);
     }
 
     // Stop timer
@@ -161,7 +159,12 @@ int main(int argc, char* argv[]) {
     chrono::duration<double> elapsed = end_time - start_time;
 
     cout << "Total primes found: " << prime_count << endl;
-    cout << "Total execution time: " << elapsed.count() << " seconds" << endl;
+    cout << "Thread pool startup time: " << pool_elapsed.count() << " seconds" << endl;
+    if (repetitions > 1) {
+        cout << "Mean execution time over " << repetitions << " runs: " << elapsed.count() / repetitions << " seconds" << endl;
+    } else {
+        cout << "Total execution time: " << elapsed.count() << " seconds" << endl;
+    }
 
     return 0;
 }
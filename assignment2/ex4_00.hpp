@@ -1,5 +1,7 @@
 #ifndef lacpp_sorted_list_hpp
 #define lacpp_sorted_list_hpp lacpp_sorted_list_hpp
+#include <algorithm>
+#include <vector>
 #include <mutex>
 
 using namespace std;
@@ -108,6 +110,115 @@ class sorted_list {
 			}
 			return cnt;
 		}
+
+		/* insert all values of a batch in a single pass over the list */
+		void insert_batch(std::vector<T> values) {
+			std::sort(values.begin(), values.end());
+			node<T>* pred = nullptr;
+			node<T>* succ = first;
+			for(const T& v : values) {
+				while(succ != nullptr && succ->value < v) {
+					pred = succ;
+					succ = succ->next;
+				}
+				node<T>* current = new node<T>();
+				current->value = v;
+				current->next = succ;
+				if(pred == nullptr) {
+					first = current;
+				} else {
+					pred->next = current;
+				}
+				/* the next value is not smaller, so continue after the new node */
+				pred = current;
+			}
+		}
+
+		/* remove one copy of every value of a batch in a single pass */
+		void remove_batch(std::vector<T> values) {
+			std::sort(values.begin(), values.end());
+			node<T>* pred = nullptr;
+			node<T>* current = first;
+			for(const T& v : values) {
+				while(current != nullptr && current->value < v) {
+					pred = current;
+					current = current->next;
+				}
+				if(current == nullptr || current->value != v) {
+					/* v not found */
+					continue;
+				}
+				node<T>* next = current->next;
+				if(pred == nullptr) {
+					first = next;
+				} else {
+					pred->next = next;
+				}
+				delete current;
+				current = next;
+			}
+		}
+
+		/* count elements for every value of a batch in a single pass,
+		 * counts are returned in the order of values */
+		std::vector<std::size_t> count_batch(const std::vector<T>& values) {
+			std::vector<std::size_t> order(values.size());
+			for(std::size_t i = 0; i < order.size(); i++) {
+				order[i] = i;
+			}
+			std::sort(order.begin(), order.end(), [&values](std::size_t a, std::size_t b) {
+				return values[a] < values[b];
+			});
+			std::vector<std::size_t> counts(values.size());
+			node<T>* current = first;
+			for(std::size_t k = 0; k < order.size(); k++) {
+				const T& v = values[order[k]];
+				if(k > 0 && values[order[k - 1]] == v) {
+					counts[order[k]] = counts[order[k - 1]];
+					continue;
+				}
+				while(current != nullptr && current->value < v) {
+					current = current->next;
+				}
+				std::size_t cnt = 0;
+				while(current != nullptr && current->value == v) {
+					cnt++;
+					current = current->next;
+				}
+				counts[order[k]] = cnt;
+			}
+			return counts;
+		}
+
+		/* count elements with lo <= value < hi */
+		std::size_t count_range(T lo, T hi) {
+			std::size_t cnt = 0;
+			/* first go to lo */
+			node<T>* current = first;
+			while(current != nullptr && current->value < lo) {
+				current = current->next;
+			}
+			/* count elements up to hi */
+			while(current != nullptr && current->value < hi) {
+				cnt++;
+				current = current->next;
+			}
+			return cnt;
+		}
+
+		/* copy of the elements with lo <= value < hi, in ascending order */
+		std::vector<T> snapshot(T lo, T hi) {
+			std::vector<T> values;
+			node<T>* current = first;
+			while(current != nullptr && current->value < lo) {
+				current = current->next;
+			}
+			while(current != nullptr && current->value < hi) {
+				values.push_back(current->value);
+				current = current->next;
+			}
+			return values;
+		}
 };
 
 #endif // lacpp_sorted_list_hpp
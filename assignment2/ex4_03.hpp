@@ -1,6 +1,8 @@
 // Coarse Grained Locking using TATAS.
 #ifndef lacpp_sorted_list_hpp
 #define lacpp_sorted_list_hpp lacpp_sorted_list_hpp
+#include <algorithm>
+#include <vector>
 #include "ex4_locks.hpp"
 
 /* a sorted list implementation by David Klaftenegger, 2015
@@ -20,7 +22,7 @@ struct node {
 template<typename T>
 class sorted_list {
 	node<T>* first = nullptr;
-    TATASLock hold;
+    LIST_LOCK(TATASLock) hold;
 
 	public:
 		/* default implementations:
@@ -45,7 +47,7 @@ class sorted_list {
 		}
 		/* insert v into the list */
 		void insert(T v) {
-            lock_guard_custom<TATASLock> lock(hold);
+            lock_guard_custom<decltype(hold)> lock(hold);
 			/* first find position */
 			node<T>* pred = nullptr;
 			node<T>* succ = first;
@@ -68,7 +70,7 @@ class sorted_list {
 		}
 
 		void remove(T v) {
-            lock_guard_custom<TATASLock> lock(hold);
+            lock_guard_custom<decltype(hold)> lock(hold);
 			/* first find position */
 			node<T>* pred = nullptr;
 			node<T>* current = first;
@@ -91,7 +93,7 @@ class sorted_list {
 
 		/* count elements with value v in the list */
 		std::size_t count(T v) {
-            lock_guard_custom<TATASLock> lock(hold);
+            lock_guard_custom<decltype(hold)> lock(hold);
 			std::size_t cnt = 0;
 			/* first go to value v */
 			node<T>* current = first;
@@ -105,6 +107,129 @@ class sorted_list {
 			}
 			return cnt;
 		}
+
+		/* insert all values of a batch in a single pass over the list */
+		void insert_batch(std::vector<T> values) {
+			std::sort(values.begin(), values.end());
+            lock_guard_custom<decltype(hold)> lock(hold);
+			node<T>* pred = nullptr;
+			node<T>* succ = first;
+			for(const T& v : values) {
+				while(succ != nullptr && succ->value < v) {
+					pred = succ;
+					succ = succ->next;
+				}
+				node<T>* current = new node<T>();
+				current->value = v;
+				current->next = succ;
+				if(pred == nullptr) {
+					first = current;
+				} else {
+					pred->next = current;
+				}
+				/* the next value is not smaller, so continue after the new node */
+				pred = current;
+			}
+		}
+
+		/* remove one copy of every value of a batch in a single pass */
+		void remove_batch(std::vector<T> values) {
+			std::sort(values.begin(), values.end());
+            lock_guard_custom<decltype(hold)> lock(hold);
+			node<T>* pred = nullptr;
+			node<T>* current = first;
+			for(const T& v : values) {
+				while(current != nullptr && current->value < v) {
+					pred = current;
+					current = current->next;
+				}
+				if(current == nullptr || current->value != v) {
+					/* v not found */
+					continue;
+				}
+				node<T>* next = current->next;
+				if(pred == nullptr) {
+					first = next;
+				} else {
+					pred->next = next;
+				}
+				delete current;
+				current = next;
+			}
+		}
+
+		/* count elements for every value of a batch in a single pass,
+		 * counts are returned in the order of values */
+		std::vector<std::size_t> count_batch(const std::vector<T>& values) {
+			std::vector<std::size_t> order(values.size());
+			for(std::size_t i = 0; i < order.size(); i++) {
+				order[i] = i;
+			}
+			std::sort(order.begin(), order.end(), [&values](std::size_t a, std::size_t b) {
+				return values[a] < values[b];
+			});
+			std::vector<std::size_t> counts(values.size());
+            lock_guard_custom<decltype(hold)> lock(hold);
+			node<T>* current = first;
+			for(std::size_t k = 0; k < order.size(); k++) {
+				const T& v = values[order[k]];
+				if(k > 0 && values[order[k - 1]] == v) {
+					counts[order[k]] = counts[order[k - 1]];
+					continue;
+				}
+				while(current != nullptr && current->value < v) {
+					current = current->next;
+				}
+				std::size_t cnt = 0;
+				while(current != nullptr && current->value == v) {
+					cnt++;
+					current = current->next;
+				}
+				counts[order[k]] = cnt;
+			}
+			return counts;
+		}
+
+		/* count elements with lo <= value < hi */
+		std::size_t count_range(T lo, T hi) {
+            lock_guard_custom<decltype(hold)> lock(hold);
+			std::size_t cnt = 0;
+			/* first go to lo */
+			node<T>* current = first;
+			while(current != nullptr && current->value < lo) {
+				current = current->next;
+			}
+			/* count elements up to hi */
+			while(current != nullptr && current->value < hi) {
+				cnt++;
+				current = current->next;
+			}
+			return cnt;
+		}
+
+		/* copy of the elements with lo <= value < hi, in ascending order,
+		 * the lock is held for the whole scan, so it is a snapshot of the list */
+		std::vector<T> snapshot(T lo, T hi) {
+            lock_guard_custom<decltype(hold)> lock(hold);
+			std::vector<T> values;
+			node<T>* current = first;
+			while(current != nullptr && current->value < lo) {
+				current = current->next;
+			}
+			while(current != nullptr && current->value < hi) {
+				values.push_back(current->value);
+				current = current->next;
+			}
+			return values;
+		}
+
+#ifdef INSTRUMENT_LOCKS
+		/* print the statistics of the list lock since the last report */
+		void report_statistics(std::ostream& out) {
+			hold.stats().report(out, u8"list lock");
+			hold.reset_stats();
+		}
+#endif
 };
 
 #endif // lacpp_sorted_list_hpp
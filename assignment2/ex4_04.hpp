@@ -1,6 +1,8 @@
 // Fine Grained Locking using TATAS.
 #ifndef lacpp_sorted_list_hpp
 #define lacpp_sorted_list_hpp lacpp_sorted_list_hpp
+#include <algorithm>
+#include <vector>
 #include "ex4_locks.hpp"
 
 /* a sorted list implementation by David Klaftenegger, 2015
@@ -14,7 +16,7 @@ template<typename T>
 struct node {
     T value;
     node<T>* next;
-    TATASLock hold;
+    LIST_LOCK(TATASLock) hold;
 };
 
 /* non-concurrent sorted singly-linked list */
@@ -24,6 +26,44 @@ private:
     // A dummy head node simplify logic
     node<T>* head_node;
 
+    /* visit the values with lo <= value < hi in ascending order.
+     * Up to lo this is the usual hand-over-hand traversal, but from the
+     * predecessor of the range on no lock is released before the first node
+     * at or after hi is locked. Nobody can insert into or remove from a
+     * locked stretch, so the visited values are exactly the range at the
+     * moment the last lock was taken, and all threads lock in list order,
+     * so this cannot deadlock. */
+    template<typename Visit>
+    void scan_range(T lo, T hi, Visit visit) {
+        node<T>* pred = head_node;
+        pred->hold.lock();
+
+        node<T>* curr = pred->next;
+        if (curr) curr->hold.lock();
+
+        while (curr != nullptr && curr->value < lo) {
+            pred->hold.unlock();
+            pred = curr;
+            curr = curr->next;
+            if (curr) curr->hold.lock();
+        }
+
+        node<T>* start = pred;
+        while (curr != nullptr && curr->value < hi) {
+            visit(curr->value);
+            curr = curr->next;
+            if (curr) curr->hold.lock();
+        }
+
+        /* next has to be read before the node is unlocked */
+        while (start != curr) {
+            node<T>* next = start->next;
+            start->hold.unlock();
+            start = next;
+        }
+        if (curr) curr->hold.unlock();
+    }
+
 public:
     /* default implementations:
      * default constructor
@@ -142,6 +182,143 @@ public:
 
         return cnt;
     }
+
+    /* insert all values of a batch in a single hand-over-hand pass */
+    void insert_batch(std::vector<T> values) {
+        std::sort(values.begin(), values.end());
+        node<T>* pred = head_node;
+        pred->hold.lock();
+
+        node<T>* curr = pred->next;
+        if (curr) curr->hold.lock();
+
+        for (const T& v : values) {
+            while (curr != nullptr && curr->value < v) {
+                pred->hold.unlock();
+                pred = curr;
+                curr = curr->next;
+                if (curr) curr->hold.lock();
+            }
+
+            node<T>* new_node = new node<T>();
+            new_node->value = v;
+            new_node->next = curr;
+            /* the new node is only reachable through pred, which we hold,
+             * so locking it cannot block */
+            new_node->hold.lock();
+            pred->next = new_node;
+
+            /* the next value is not smaller, so continue after the new node */
+            pred->hold.unlock();
+            pred = new_node;
+        }
+
+        if (curr) curr->hold.unlock();
+        pred->hold.unlock();
+    }
+
+    /* remove one copy of every value of a batch in a single pass */
+    void remove_batch(std::vector<T> values) {
+        std::sort(values.begin(), values.end());
+        node<T>* pred = head_node;
+        pred->hold.lock();
+
+        node<T>* curr = pred->next;
+        if (curr) curr->hold.lock();
+
+        for (const T& v : values) {
+            while (curr != nullptr && curr->value < v) {
+                pred->hold.unlock();
+                pred = curr;
+                curr = curr->next;
+                if (curr) curr->hold.lock();
+            }
+
+            if (curr != nullptr && curr->value == v) {
+                node<T>* next = curr->next;
+                pred->next = next;
+                /* nobody waits for curr: that needs pred's lock */
+                curr->hold.unlock();
+                delete curr;
+                curr = next;
+                if (curr) curr->hold.lock();
+            }
+        }
+
+        if (curr) curr->hold.unlock();
+        pred->hold.unlock();
+    }
+
+    /* count elements for every value of a batch in a single pass,
+     * counts are returned in the order of values */
+    std::vector<std::size_t> count_batch(const std::vector<T>& values) {
+        std::vector<std::size_t> order(values.size());
+        for (std::size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&values](std::size_t a, std::size_t b) {
+            return values[a] < values[b];
+        });
+        std::vector<std::size_t> counts(values.size());
+
+        node<T>* pred = head_node;
+        pred->hold.lock();
+
+        node<T>* current = pred->next;
+        if (current) current->hold.lock();
+
+        for (std::size_t k = 0; k < order.size(); k++) {
+            const T& v = values[order[k]];
+            if (k > 0 && values[order[k - 1]] == v) {
+                counts[order[k]] = counts[order[k - 1]];
+                continue;
+            }
+
+            while (current != nullptr && current->value < v) {
+                pred->hold.unlock();
+                pred = current;
+                current = current->next;
+                if (current) current->hold.lock();
+            }
+
+            std::size_t cnt = 0;
+            while (current != nullptr && current->value == v) {
+                cnt++;
+                pred->hold.unlock();
+                pred = current;
+                current = current->next;
+                if (current) current->hold.lock();
+            }
+            counts[order[k]] = cnt;
+        }
+
+        if (current) current->hold.unlock();
+        pred->hold.unlock();
+
+        return counts;
+    }
+
+    /* count elements with lo <= value < hi */
+    std::size_t count_range(T lo, T hi) {
+        std::size_t cnt = 0;
+        scan_range(lo, hi, [&cnt](const T&) { cnt++; });
+        return cnt;
+    }
+
+    /* copy of the elements with lo <= value < hi, in ascending order */
+    std::vector<T> snapshot(T lo, T hi) {
+        std::vector<T> values;
+        scan_range(lo, hi, [&values](const T& v) { values.push_back(v); });
+        return values;
+    }
+
+#ifdef INSTRUMENT_LOCKS
+    /* print the node lock statistics since the last report, see
+     * report_lock_bands */
+    void report_statistics(std::ostream& out) {
+        report_lock_bands(out, head_node);
+    }
+#endif
 };
 
 #endif // lacpp_sorted_list_hpp
@@ -1,5 +1,6 @@
 #ifndef lacpp_sorted_list_hpp
 #define lacpp_sorted_list_hpp lacpp_sorted_list_hpp
+#include <vector>
 
 #include "ex4_locks.hpp" 
 
@@ -119,6 +120,57 @@ public:
         }
         return cnt;
     }
+
+    /* batch operations. The CLH locks of this variant do not work yet, so
+     * there is no merged traversal here: every value is handled on its own */
+    void insert_batch(std::vector<T> values) {
+        for (const T& v : values) {
+            insert(v);
+        }
+    }
+
+    void remove_batch(std::vector<T> values) {
+        for (const T& v : values) {
+            remove(v);
+        }
+    }
+
+    std::vector<std::size_t> count_batch(const std::vector<T>& values) {
+        std::vector<std::size_t> counts;
+        for (const T& v : values) {
+            counts.push_back(count(v));
+        }
+        return counts;
+    }
+
+    /* range operations, node by node like count. Nodes are only locked one
+     * at a time, so concurrent updates can show up in a scan */
+    std::size_t count_range(T lo, T hi) {
+        return snapshot(lo, hi).size();
+    }
+
+    std::vector<T> snapshot(T lo, T hi) {
+        std::vector<T> values;
+
+        node<T>* curr = head_node->next;
+        CLHNode* curr_lock = nullptr;
+
+        while (curr != nullptr && curr->value < lo) {
+            curr_lock = curr->lock.lock();
+            node<T>* next = curr->next;
+            curr->lock.unlock(curr_lock);
+            curr = next;
+        }
+
+        while (curr != nullptr && curr->value < hi) {
+            curr_lock = curr->lock.lock();
+            values.push_back(curr->value);
+            node<T>* next = curr->next;
+            curr->lock.unlock(curr_lock);
+            curr = next;
+        }
+        return values;
+    }
 };
 
 #endif // lacpp_sorted_list_hpp
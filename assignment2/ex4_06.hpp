@@ -0,0 +1,216 @@
+// Coarse Grained Locking using std::mutex, duplicates stored as run lengths.
+#ifndef lacpp_sorted_list_hpp
+#define lacpp_sorted_list_hpp lacpp_sorted_list_hpp
+#include <algorithm>
+#include <vector>
+#include <mutex>
+
+/* a sorted list implementation by David Klaftenegger, 2015
+ * please report bugs or suggest improvements to david.klaftenegger@it.uu.se
+ */
+
+
+/* struct for list nodes: multiplicity copies of value */
+
+template<typename T>
+struct node {
+	T value;
+	std::size_t multiplicity;
+	node<T>* next;
+};
+
+/* concurrent sorted singly-linked list with one node per distinct value.
+ * Values are strictly increasing along the list and every node has a
+ * multiplicity of at least one, so inserting or removing a duplicate
+ * only changes a counter and count() stops at the first node >= v. */
+template<typename T>
+class sorted_list {
+	node<T>* first = nullptr;
+	std::mutex hold;
+
+	/* first node with value >= v, pred is set to the node before it */
+	node<T>* find(T v, node<T>*& pred) {
+		pred = nullptr;
+		node<T>* current = first;
+		while(current != nullptr && current->value < v) {
+			pred = current;
+			current = current->next;
+		}
+		return current;
+	}
+
+	/* add one copy of v, current is the first node >= v */
+	node<T>* add(T v, node<T>* pred, node<T>* current) {
+		if(current != nullptr && current->value == v) {
+			current->multiplicity++;
+			return current;
+		}
+		node<T>* fresh = new node<T>();
+		fresh->value = v;
+		fresh->multiplicity = 1;
+		fresh->next = current;
+		if(pred == nullptr) {
+			first = fresh;
+		} else {
+			pred->next = fresh;
+		}
+		return fresh;
+	}
+
+	/* take one copy of current away, returns the node now in its place */
+	node<T>* take(node<T>* pred, node<T>* current) {
+		if(--current->multiplicity > 0) {
+			return current;
+		}
+		node<T>* next = current->next;
+		if(pred == nullptr) {
+			first = next;
+		} else {
+			pred->next = next;
+		}
+		delete current;
+		return next;
+	}
+
+	public:
+		/* default implementations:
+		 * default constructor
+		 * copy constructor (note: shallow copy)
+		 * move constructor
+		 * copy assignment operator (note: shallow copy)
+		 * move assignment operator
+		 *
+		 * The first is required due to the others,
+		 * which are explicitly listed due to the rule of five.
+		 */
+		sorted_list() = default;
+		sorted_list(const sorted_list<T>& other) = default;
+		sorted_list(sorted_list<T>&& other) = default;
+		sorted_list<T>& operator=(const sorted_list<T>& other) = default;
+		sorted_list<T>& operator=(sorted_list<T>&& other) = default;
+		~sorted_list() {
+			while(first != nullptr) {
+				node<T>* next = first->next;
+				delete first;
+				first = next;
+			}
+		}
+
+		/* insert v into the list */
+		void insert(T v) {
+			std::lock_guard<std::mutex> lock(hold);
+			node<T>* pred;
+			node<T>* current = find(v, pred);
+			add(v, pred, current);
+		}
+
+		void remove(T v) {
+			std::lock_guard<std::mutex> lock(hold);
+			node<T>* pred;
+			node<T>* current = find(v, pred);
+			if(current == nullptr || current->value != v) {
+				/* v not found */
+				return;
+			}
+			take(pred, current);
+		}
+
+		/* count elements with value v in the list */
+		std::size_t count(T v) {
+			std::lock_guard<std::mutex> lock(hold);
+			node<T>* pred;
+			node<T>* current = find(v, pred);
+			if(current == nullptr || current->value != v) {
+				return 0;
+			}
+			return current->multiplicity;
+		}
+
+		/* insert all values of a batch in a single pass over the list */
+		void insert_batch(std::vector<T> values) {
+			std::sort(values.begin(), values.end());
+			std::lock_guard<std::mutex> lock(hold);
+			node<T>* pred = nullptr;
+			node<T>* current = first;
+			for(const T& v : values) {
+				while(current != nullptr && current->value < v) {
+					pred = current;
+					current = current->next;
+				}
+				current = add(v, pred, current);
+			}
+		}
+
+		/* remove one copy of every value of a batch in a single pass */
+		void remove_batch(std::vector<T> values) {
+			std::sort(values.begin(), values.end());
+			std::lock_guard<std::mutex> lock(hold);
+			node<T>* pred = nullptr;
+			node<T>* current = first;
+			for(const T& v : values) {
+				while(current != nullptr && current->value < v) {
+					pred = current;
+					current = current->next;
+				}
+				if(current == nullptr || current->value != v) {
+					/* v not found */
+					continue;
+				}
+				current = take(pred, current);
+			}
+		}
+
+		/* count elements for every value of a batch in a single pass,
+		 * counts are returned in the order of values */
+		std::vector<std::size_t> count_batch(const std::vector<T>& values) {
+			std::vector<std::size_t> order(values.size());
+			for(std::size_t i = 0; i < order.size(); i++) {
+				order[i] = i;
+			}
+			std::sort(order.begin(), order.end(), [&values](std::size_t a, std::size_t b) {
+				return values[a] < values[b];
+			});
+			std::vector<std::size_t> counts(values.size());
+			std::lock_guard<std::mutex> lock(hold);
+			node<T>* current = first;
+			for(std::size_t i : order) {
+				const T& v = values[i];
+				while(current != nullptr && current->value < v) {
+					current = current->next;
+				}
+				if(current != nullptr && current->value == v) {
+					counts[i] = current->multiplicity;
+				}
+			}
+			return counts;
+		}
+
+		/* count elements with lo <= value < hi */
+		std::size_t count_range(T lo, T hi) {
+			std::lock_guard<std::mutex> lock(hold);
+			std::size_t cnt = 0;
+			node<T>* pred;
+			node<T>* current = find(lo, pred);
+			while(current != nullptr && current->value < hi) {
+				cnt += current->multiplicity;
+				current = current->next;
+			}
+			return cnt;
+		}
+
+		/* copy of the elements with lo <= value < hi, in ascending order,
+		 * the lock is held for the whole scan, so it is a snapshot of the list */
+		std::vector<T> snapshot(T lo, T hi) {
+			std::lock_guard<std::mutex> lock(hold);
+			std::vector<T> values;
+			node<T>* pred;
+			node<T>* current = find(lo, pred);
+			while(current != nullptr && current->value < hi) {
+				values.insert(values.end(), current->multiplicity, current->value);
+				current = current->next;
+			}
+			return values;
+		}
+};
+
+#endif // lacpp_sorted_list_hpp
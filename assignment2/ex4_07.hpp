@@ -0,0 +1,301 @@
+// Fine Grained Locking using std::mutex on an unrolled list.
+#ifndef lacpp_sorted_list_hpp
+#define lacpp_sorted_list_hpp lacpp_sorted_list_hpp
+#include <algorithm>
+#include <vector>
+#include <mutex>
+
+/* a sorted list implementation by David Klaftenegger, 2015
+ * please report bugs or suggest improvements to david.klaftenegger@it.uu.se
+ */
+
+/* bytes of keys per chunk: four cache lines */
+static const std::size_t CHUNK_KEY_BYTES = 256;
+
+/* struct for list chunks: a sorted array of up to capacity keys */
+template<typename T>
+struct chunk {
+    static const std::size_t capacity = CHUNK_KEY_BYTES / sizeof(T) > 2 ? CHUNK_KEY_BYTES / sizeof(T) : 2;
+    T keys[capacity];
+    std::size_t size;
+    chunk<T>* next;
+    std::mutex hold;
+};
+
+/* concurrent sorted unrolled linked list with one std::mutex per chunk.
+ *
+ * All keys of a chunk are <= all keys of the chunks after it, so runs of
+ * equal keys may span chunks. The first chunk is never removed. Other
+ * chunks can become empty; a traversal that finds an empty chunk after
+ * the one it holds unlinks it. Locks are taken hand-over-hand in list
+ * order like in ex4_02. */
+template<typename T>
+class sorted_list {
+private:
+    chunk<T>* first;
+
+    static T* begin(chunk<T>* c) { return c->keys; }
+    static T* end(chunk<T>* c) { return c->keys + c->size; }
+
+    /* move the locked pair pred, curr == pred->next forward until pred
+     * is the chunk v belongs into. Afterwards curr is nullptr or a non
+     * empty chunk with curr->keys[0] >= v. */
+    void advance(chunk<T>*& pred, chunk<T>*& curr, const T& v) {
+        while (curr != nullptr && (curr->size == 0 || curr->keys[0] < v)) {
+            if (curr->size == 0) {
+                /* nobody waits for curr: that needs pred's lock */
+                pred->next = curr->next;
+                curr->hold.unlock();
+                delete curr;
+            } else {
+                pred->hold.unlock();
+                pred = curr;
+            }
+            curr = pred->next;
+            if (curr) curr->hold.lock();
+        }
+    }
+
+    /* lock the first chunk and the one after it */
+    void lock_front(chunk<T>*& pred, chunk<T>*& curr) {
+        pred = first;
+        pred->hold.lock();
+        curr = pred->next;
+        if (curr) curr->hold.lock();
+    }
+
+    void unlock_pair(chunk<T>* pred, chunk<T>* curr) {
+        if (curr) curr->hold.unlock();
+        pred->hold.unlock();
+    }
+
+    /* insert v into pred, splitting it if it is full. A new chunk is
+     * only reachable through pred, so it becomes the new curr. */
+    void insert_into(chunk<T>*& pred, chunk<T>*& curr, const T& v) {
+        chunk<T>* target = pred;
+        std::size_t pos = std::upper_bound(begin(pred), end(pred), v) - begin(pred);
+        if (pred->size == chunk<T>::capacity) {
+            std::size_t half = pred->size / 2;
+            chunk<T>* upper = new chunk<T>();
+            std::copy(begin(pred) + half, end(pred), upper->keys);
+            upper->size = pred->size - half;
+            pred->size = half;
+            upper->next = curr;
+            /* release curr first to keep locking in list order */
+            if (curr) curr->hold.unlock();
+            upper->hold.lock();
+            pred->next = upper;
+            curr = upper;
+            if (pos > half) {
+                target = upper;
+                pos -= half;
+            }
+        }
+        std::copy_backward(begin(target) + pos, end(target), end(target) + 1);
+        target->keys[pos] = v;
+        target->size++;
+    }
+
+    /* remove one copy of v from pred or the start of curr, then merge
+     * curr into pred if both are at most half full together */
+    void remove_from(chunk<T>* pred, chunk<T>*& curr, const T& v) {
+        T* p = std::lower_bound(begin(pred), end(pred), v);
+        chunk<T>* target = pred;
+        if (p == end(pred) || *p != v) {
+            if (curr == nullptr || curr->keys[0] != v) {
+                /* v not found */
+                return;
+            }
+            target = curr;
+            p = begin(curr);
+        }
+        std::copy(p + 1, end(target), p);
+        target->size--;
+
+        if (curr != nullptr && (curr->size == 0 || pred->size + curr->size <= chunk<T>::capacity / 2)) {
+            std::copy(begin(curr), end(curr), end(pred));
+            pred->size += curr->size;
+            pred->next = curr->next;
+            curr->hold.unlock();
+            delete curr;
+            curr = pred->next;
+            if (curr) curr->hold.lock();
+        }
+    }
+
+    /* count the copies of v from pred on. Whole chunks of v are passed
+     * hand-over-hand, pred stays a valid position for keys >= v. */
+    std::size_t count_from(chunk<T>*& pred, chunk<T>*& curr, const T& v) {
+        auto run = std::equal_range(begin(pred), end(pred), v);
+        std::size_t cnt = run.second - run.first;
+        while (curr != nullptr && (curr->size == 0 || curr->keys[0] == v)) {
+            cnt += std::upper_bound(begin(curr), end(curr), v) - begin(curr);
+            pred->hold.unlock();
+            pred = curr;
+            curr = curr->next;
+            if (curr) curr->hold.lock();
+        }
+        return cnt;
+    }
+
+    /* visit the keys with lo <= key < hi in ascending order. Like
+     * scan_range in ex4_02, no lock is released before the chunk after
+     * the range is locked, so the visited keys are the range at the
+     * moment the last lock was taken. */
+    template<typename Visit>
+    void scan_range(T lo, T hi, Visit visit) {
+        chunk<T>* pred;
+        chunk<T>* curr;
+        lock_front(pred, curr);
+        advance(pred, curr, lo);
+
+        for (T* p = std::lower_bound(begin(pred), end(pred), lo); p != end(pred) && *p < hi; ++p) {
+            visit(*p);
+        }
+        chunk<T>* start = pred;
+        while (curr != nullptr && (curr->size == 0 || curr->keys[0] < hi)) {
+            for (T* p = begin(curr); p != end(curr) && *p < hi; ++p) {
+                visit(*p);
+            }
+            curr = curr->next;
+            if (curr) curr->hold.lock();
+        }
+
+        /* next has to be read before the chunk is unlocked */
+        while (start != curr) {
+            chunk<T>* next = start->next;
+            start->hold.unlock();
+            start = next;
+        }
+        if (curr) curr->hold.unlock();
+    }
+
+public:
+    sorted_list() {
+        first = new chunk<T>();
+        first->size = 0;
+        first->next = nullptr;
+    }
+
+    /* default implementations:
+     * copy constructor (note: shallow copy)
+     * move constructor
+     * copy assignment operator (note: shallow copy)
+     * move assignment operator
+     *
+     * explicitly listed due to the rule of five.
+     */
+    sorted_list(const sorted_list<T>& other) = default;
+    sorted_list(sorted_list<T>&& other) = default;
+    sorted_list<T>& operator=(const sorted_list<T>& other) = default;
+    sorted_list<T>& operator=(sorted_list<T>&& other) = default;
+
+    ~sorted_list() {
+        while (first != nullptr) {
+            chunk<T>* next = first->next;
+            delete first;
+            first = next;
+        }
+    }
+
+    /* insert v into the list */
+    void insert(T v) {
+        chunk<T>* pred;
+        chunk<T>* curr;
+        lock_front(pred, curr);
+        advance(pred, curr, v);
+        insert_into(pred, curr, v);
+        unlock_pair(pred, curr);
+    }
+
+    void remove(T v) {
+        chunk<T>* pred;
+        chunk<T>* curr;
+        lock_front(pred, curr);
+        advance(pred, curr, v);
+        remove_from(pred, curr, v);
+        unlock_pair(pred, curr);
+    }
+
+    /* count elements with value v in the list */
+    std::size_t count(T v) {
+        chunk<T>* pred;
+        chunk<T>* curr;
+        lock_front(pred, curr);
+        advance(pred, curr, v);
+        std::size_t cnt = count_from(pred, curr, v);
+        unlock_pair(pred, curr);
+        return cnt;
+    }
+
+    /* insert all values of a batch in a single hand-over-hand pass */
+    void insert_batch(std::vector<T> values) {
+        std::sort(values.begin(), values.end());
+        chunk<T>* pred;
+        chunk<T>* curr;
+        lock_front(pred, curr);
+        for (const T& v : values) {
+            advance(pred, curr, v);
+            insert_into(pred, curr, v);
+        }
+        unlock_pair(pred, curr);
+    }
+
+    /* remove one copy of every value of a batch in a single pass */
+    void remove_batch(std::vector<T> values) {
+        std::sort(values.begin(), values.end());
+        chunk<T>* pred;
+        chunk<T>* curr;
+        lock_front(pred, curr);
+        for (const T& v : values) {
+            advance(pred, curr, v);
+            remove_from(pred, curr, v);
+        }
+        unlock_pair(pred, curr);
+    }
+
+    /* count elements for every value of a batch in a single pass,
+     * counts are returned in the order of values */
+    std::vector<std::size_t> count_batch(const std::vector<T>& values) {
+        std::vector<std::size_t> order(values.size());
+        for (std::size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&values](std::size_t a, std::size_t b) {
+            return values[a] < values[b];
+        });
+        std::vector<std::size_t> counts(values.size());
+
+        chunk<T>* pred;
+        chunk<T>* curr;
+        lock_front(pred, curr);
+        for (std::size_t k = 0; k < order.size(); k++) {
+            const T& v = values[order[k]];
+            if (k > 0 && values[order[k - 1]] == v) {
+                counts[order[k]] = counts[order[k - 1]];
+                continue;
+            }
+            advance(pred, curr, v);
+            counts[order[k]] = count_from(pred, curr, v);
+        }
+        unlock_pair(pred, curr);
+
+        return counts;
+    }
+
+    /* count elements with lo <= value < hi */
+    std::size_t count_range(T lo, T hi) {
+        std::size_t cnt = 0;
+        scan_range(lo, hi, [&cnt](const T&) { cnt++; });
+        return cnt;
+    }
+
+    /* copy of the elements with lo <= value < hi, in ascending order */
+    std::vector<T> snapshot(T lo, T hi) {
+        std::vector<T> values;
+        scan_range(lo, hi, [&values](const T& v) { values.push_back(v); });
+        return values;
+    }
+};
+
+#endif // lacpp_sorted_list_hpp
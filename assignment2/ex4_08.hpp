@@ -0,0 +1,167 @@
+// Lock striping using std::mutex on a hash multiset.
+#ifndef lacpp_sorted_list_hpp
+#define lacpp_sorted_list_hpp lacpp_sorted_list_hpp
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+
+#include "reduction.hpp"
+
+/* number of stripes if none is given */
+static const std::size_t HASH_STRIPES = 64;
+
+/* concurrent multiset with the insert/remove/count interface of the sorted
+ * lists. A value lives in the stripe its hash selects; every stripe maps
+ * values to their multiplicity under a std::mutex of its own, so point
+ * operations on different stripes never share a lock.
+ *
+ * There is no order between stripes, so count_range and snapshot lock all
+ * stripes in index order and look at every distinct value. */
+template<typename T>
+class hash_multiset {
+private:
+    struct stripe {
+        std::mutex hold;
+        std::unordered_map<T, std::size_t> counts;
+        /* keeps the lock of the next stripe off this stripe's lines */
+        char padding[CACHE_LINE_SIZE];
+    };
+
+    std::vector<stripe> stripes;
+    std::hash<T> hash;
+
+    std::size_t stripe_of(const T& v) const {
+        return hash(v) % stripes.size();
+    }
+
+    /* indices of values, grouped by stripe */
+    std::vector<std::size_t> by_stripe(const std::vector<T>& values) const {
+        std::vector<std::size_t> order(values.size());
+        for (std::size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [this, &values](std::size_t a, std::size_t b) {
+            return stripe_of(values[a]) < stripe_of(values[b]);
+        });
+        return order;
+    }
+
+    /* call fun(stripe, index) for values[index] in order, taking each
+     * stripe's lock once for all its values */
+    template<typename Fun>
+    void per_stripe(const std::vector<T>& values, Fun fun) {
+        std::vector<std::size_t> order = by_stripe(values);
+        std::size_t k = 0;
+        while (k < order.size()) {
+            std::size_t s = stripe_of(values[order[k]]);
+            std::lock_guard<std::mutex> lock(stripes[s].hold);
+            for (; k < order.size() && stripe_of(values[order[k]]) == s; k++) {
+                fun(stripes[s], order[k]);
+            }
+        }
+    }
+
+    static void add(stripe& s, const T& v) {
+        s.counts[v]++;
+    }
+
+    static void take(stripe& s, const T& v) {
+        auto it = s.counts.find(v);
+        if (it == s.counts.end()) {
+            /* v not found */
+            return;
+        }
+        if (--it->second == 0) {
+            s.counts.erase(it);
+        }
+    }
+
+    static std::size_t lookup(stripe& s, const T& v) {
+        auto it = s.counts.find(v);
+        return it == s.counts.end() ? 0 : it->second;
+    }
+
+    /* visit (value, multiplicity) of all values with lo <= value < hi,
+     * in no particular order, with all stripes locked */
+    template<typename Visit>
+    void scan_range(T lo, T hi, Visit visit) {
+        for (auto& s : stripes) {
+            s.hold.lock();
+        }
+        for (auto& s : stripes) {
+            for (auto& entry : s.counts) {
+                if (!(entry.first < lo) && entry.first < hi) {
+                    visit(entry.first, entry.second);
+                }
+            }
+        }
+        for (auto& s : stripes) {
+            s.hold.unlock();
+        }
+    }
+
+public:
+    explicit hash_multiset(std::size_t stripe_count = HASH_STRIPES) : stripes(stripe_count ? stripe_count : 1) {}
+
+    hash_multiset(const hash_multiset<T>& other) = delete;
+    hash_multiset<T>& operator=(const hash_multiset<T>& other) = delete;
+
+    /* insert v into the set */
+    void insert(T v) {
+        stripe& s = stripes[stripe_of(v)];
+        std::lock_guard<std::mutex> lock(s.hold);
+        add(s, v);
+    }
+
+    void remove(T v) {
+        stripe& s = stripes[stripe_of(v)];
+        std::lock_guard<std::mutex> lock(s.hold);
+        take(s, v);
+    }
+
+    /* count elements with value v in the set */
+    std::size_t count(T v) {
+        stripe& s = stripes[stripe_of(v)];
+        std::lock_guard<std::mutex> lock(s.hold);
+        return lookup(s, v);
+    }
+
+    /* batch operations take the lock of every stripe they touch once */
+    void insert_batch(std::vector<T> values) {
+        per_stripe(values, [&values](stripe& s, std::size_t i) { add(s, values[i]); });
+    }
+
+    void remove_batch(std::vector<T> values) {
+        per_stripe(values, [&values](stripe& s, std::size_t i) { take(s, values[i]); });
+    }
+
+    /* counts are returned in the order of values */
+    std::vector<std::size_t> count_batch(const std::vector<T>& values) {
+        std::vector<std::size_t> counts(values.size());
+        per_stripe(values, [&values, &counts](stripe& s, std::size_t i) { counts[i] = lookup(s, values[i]); });
+        return counts;
+    }
+
+    /* count elements with lo <= value < hi */
+    std::size_t count_range(T lo, T hi) {
+        std::size_t cnt = 0;
+        scan_range(lo, hi, [&cnt](const T&, std::size_t n) { cnt += n; });
+        return cnt;
+    }
+
+    /* copy of the elements with lo <= value < hi, in ascending order */
+    std::vector<T> snapshot(T lo, T hi) {
+        std::vector<T> values;
+        scan_range(lo, hi, [&values](const T& v, std::size_t n) { values.insert(values.end(), n, v); });
+        std::sort(values.begin(), values.end());
+        return values;
+    }
+};
+
+/* so benchmark_example can select it like the list variants */
+template<typename T>
+using sorted_list = hash_multiset<T>;
+
+#endif // lacpp_sorted_list_hpp
@@ -0,0 +1,217 @@
+// Read-copy-update: lock free readers, writers serialized by a std::mutex.
+#ifndef lacpp_sorted_list_hpp
+#define lacpp_sorted_list_hpp lacpp_sorted_list_hpp
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+#include <mutex>
+
+#include "rcu.hpp"
+
+/* a sorted list implementation by David Klaftenegger, 2015
+ * please report bugs or suggest improvements to david.klaftenegger@it.uu.se
+ */
+
+/* retired nodes collected before a writer tries to free them */
+static const std::size_t RCU_RETIRE_THRESHOLD = 64;
+
+/* struct for list nodes */
+template<typename T>
+struct node {
+    T value;
+    std::atomic<node<T>*> next;
+};
+
+/* concurrent sorted singly-linked list with read-copy-update.
+ *
+ * count() traverses inside an rcu_read_guard and takes no lock, so readers
+ * only write their own reader slot. Writers take the list mutex, link new
+ * nodes with a release store and retire unlinked nodes; a retired node is
+ * freed once no reader that could still see it is in a read section.
+ * count_range and snapshot take the writer mutex to see one consistent
+ * state of the whole range. */
+template<typename T>
+class sorted_list {
+private:
+    std::atomic<node<T>*> first;
+    std::mutex hold;
+    /* (epoch at unlinking, node), only accessed with hold */
+    std::vector<std::pair<unsigned long, node<T>*>> retired;
+
+    /* first link whose node is >= v, writers only */
+    std::atomic<node<T>*>* find_link(std::atomic<node<T>*>* link, const T& v) {
+        node<T>* current = link->load(std::memory_order_relaxed);
+        while (current != nullptr && current->value < v) {
+            link = &current->next;
+            current = link->load(std::memory_order_relaxed);
+        }
+        return link;
+    }
+
+    /* link a new node with value v at link, returns the new node's link */
+    std::atomic<node<T>*>* link_new(std::atomic<node<T>*>* link, const T& v) {
+        node<T>* fresh = new node<T>();
+        fresh->value = v;
+        fresh->next.store(link->load(std::memory_order_relaxed), std::memory_order_relaxed);
+        /* readers that see the node see its value and next */
+        link->store(fresh, std::memory_order_release);
+        return &fresh->next;
+    }
+
+    /* unlink the node at link and retire it */
+    void unlink(std::atomic<node<T>*>* link) {
+        node<T>* current = link->load(std::memory_order_relaxed);
+        /* readers on current still find their way on through its next */
+        link->store(current->next.load(std::memory_order_relaxed), std::memory_order_release);
+        retired.push_back(std::make_pair(rcu_global_domain().current(), current));
+        if (retired.size() >= RCU_RETIRE_THRESHOLD) {
+            reclaim();
+        }
+    }
+
+    /* free the retired nodes no reader can reach any more */
+    void reclaim() {
+        rcu_domain& domain = rcu_global_domain();
+        domain.advance();
+        unsigned long oldest = domain.oldest_reader();
+        auto keep = std::partition(retired.begin(), retired.end(),
+            [oldest](const std::pair<unsigned long, node<T>*>& r) { return r.first >= oldest; });
+        for (auto it = keep; it != retired.end(); ++it) {
+            delete it->second;
+        }
+        retired.erase(keep, retired.end());
+    }
+
+    /* count the run of v starting at current, reader side */
+    static std::size_t count_run(node<T>*& current, const T& v) {
+        while (current != nullptr && current->value < v) {
+            current = current->next.load(std::memory_order_acquire);
+        }
+        std::size_t cnt = 0;
+        while (current != nullptr && current->value == v) {
+            cnt++;
+            current = current->next.load(std::memory_order_acquire);
+        }
+        return cnt;
+    }
+
+public:
+    sorted_list() : first(nullptr) {}
+
+    sorted_list(const sorted_list<T>& other) = delete;
+    sorted_list<T>& operator=(const sorted_list<T>& other) = delete;
+
+    /* no reader may be left when the list is destroyed */
+    ~sorted_list() {
+        node<T>* current = first.load();
+        while (current != nullptr) {
+            node<T>* next = current->next.load();
+            delete current;
+            current = next;
+        }
+        for (auto& r : retired) {
+            delete r.second;
+        }
+    }
+
+    /* insert v into the list */
+    void insert(T v) {
+        std::lock_guard<std::mutex> lock(hold);
+        link_new(find_link(&first, v), v);
+    }
+
+    void remove(T v) {
+        std::lock_guard<std::mutex> lock(hold);
+        std::atomic<node<T>*>* link = find_link(&first, v);
+        node<T>* current = link->load(std::memory_order_relaxed);
+        if (current == nullptr || current->value != v) {
+            /* v not found */
+            return;
+        }
+        unlink(link);
+    }
+
+    /* count elements with value v in the list */
+    std::size_t count(T v) {
+        rcu_read_guard guard;
+        node<T>* current = first.load(std::memory_order_acquire);
+        return count_run(current, v);
+    }
+
+    /* insert all values of a batch in a single pass over the list */
+    void insert_batch(std::vector<T> values) {
+        std::sort(values.begin(), values.end());
+        std::lock_guard<std::mutex> lock(hold);
+        std::atomic<node<T>*>* link = &first;
+        for (const T& v : values) {
+            /* the next value is not smaller, so continue after the new node */
+            link = link_new(find_link(link, v), v);
+        }
+    }
+
+    /* remove one copy of every value of a batch in a single pass */
+    void remove_batch(std::vector<T> values) {
+        std::sort(values.begin(), values.end());
+        std::lock_guard<std::mutex> lock(hold);
+        std::atomic<node<T>*>* link = &first;
+        for (const T& v : values) {
+            link = find_link(link, v);
+            node<T>* current = link->load(std::memory_order_relaxed);
+            if (current != nullptr && current->value == v) {
+                unlink(link);
+            }
+        }
+    }
+
+    /* count elements for every value of a batch in a single read section,
+     * counts are returned in the order of values */
+    std::vector<std::size_t> count_batch(const std::vector<T>& values) {
+        std::vector<std::size_t> order(values.size());
+        for (std::size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&values](std::size_t a, std::size_t b) {
+            return values[a] < values[b];
+        });
+        std::vector<std::size_t> counts(values.size());
+
+        rcu_read_guard guard;
+        node<T>* current = first.load(std::memory_order_acquire);
+        for (std::size_t k = 0; k < order.size(); k++) {
+            const T& v = values[order[k]];
+            if (k > 0 && values[order[k - 1]] == v) {
+                counts[order[k]] = counts[order[k - 1]];
+                continue;
+            }
+            counts[order[k]] = count_run(current, v);
+        }
+        return counts;
+    }
+
+    /* count elements with lo <= value < hi */
+    std::size_t count_range(T lo, T hi) {
+        std::lock_guard<std::mutex> lock(hold);
+        std::size_t cnt = 0;
+        node<T>* current = find_link(&first, lo)->load(std::memory_order_relaxed);
+        while (current != nullptr && current->value < hi) {
+            cnt++;
+            current = current->next.load(std::memory_order_relaxed);
+        }
+        return cnt;
+    }
+
+    /* copy of the elements with lo <= value < hi, in ascending order */
+    std::vector<T> snapshot(T lo, T hi) {
+        std::lock_guard<std::mutex> lock(hold);
+        std::vector<T> values;
+        node<T>* current = find_link(&first, lo)->load(std::memory_order_relaxed);
+        while (current != nullptr && current->value < hi) {
+            values.push_back(current->value);
+            current = current->next.load(std::memory_order_relaxed);
+        }
+        return values;
+    }
+};
+
+#endif // lacpp_sorted_list_hpp
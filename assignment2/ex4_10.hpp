@@ -0,0 +1,336 @@
+// Coarse Grained Locking using TATAS for writers, seqlock for readers.
+#ifndef lacpp_sorted_list_hpp
+#define lacpp_sorted_list_hpp lacpp_sorted_list_hpp
+#include <algorithm>
+#include <atomic>
+#include <ostream>
+#include <thread>
+#include <vector>
+#include "ex4_locks.hpp"
+#include "reduction.hpp"
+
+/* a sorted list implementation by David Klaftenegger, 2015
+ * please report bugs or suggest improvements to david.klaftenegger@it.uu.se
+ */
+
+/* nodes a reader visits between two checks of the sequence number */
+static const std::size_t SEQLOCK_CHECK_INTERVAL = 64;
+/* per-thread statistics slots, threads beyond that share slots */
+static const std::size_t SEQLOCK_STAT_SLOTS = 64;
+
+/* struct for list nodes, readers may look at them during a write */
+
+template<typename T>
+struct node {
+	std::atomic<T> value;
+	std::atomic<node<T>*> next;
+};
+
+/* statistics slot of the calling thread */
+inline std::size_t seqlock_stat_slot() {
+	static std::atomic<std::size_t> next_slot(0);
+	thread_local std::size_t slot = next_slot++ % SEQLOCK_STAT_SLOTS;
+	return slot;
+}
+
+/* concurrent sorted singly-linked list behind a sequence lock.
+ *
+ * Writers take the TATAS lock and make the sequence number odd while they
+ * change the list. Readers do not write shared memory: they traverse
+ * optimistically and retry if the sequence number was odd or changed, so
+ * readers run in parallel and also get a consistent count_range and
+ * snapshot. Removed nodes go to a free list and are only deleted with the
+ * list, so a reader racing with a writer never touches freed memory; it
+ * may follow stale links, which the sequence check catches. */
+template<typename T>
+class sorted_list {
+	struct alignas(CACHE_LINE_SIZE) stat_slot {
+		std::atomic<unsigned long> reads;
+		std::atomic<unsigned long> retries;
+		std::atomic<unsigned long> writes;
+		std::atomic<unsigned long> contended;
+	};
+
+	std::atomic<node<T>*> first;
+	std::atomic<unsigned long> sequence;
+	TATASLock hold;
+	node<T>* free_nodes = nullptr; // only accessed with hold
+	stat_slot stats[SEQLOCK_STAT_SLOTS];
+
+	/* makes the sequence number odd for the lifetime of a write */
+	class write_guard {
+		sorted_list<T>& list;
+		public:
+			explicit write_guard(sorted_list<T>& l) : list(l) {
+				stat_slot& s = list.stats[seqlock_stat_slot()];
+				s.writes.fetch_add(1, std::memory_order_relaxed);
+				if(!list.hold.try_lock()) {
+					s.contended.fetch_add(1, std::memory_order_relaxed);
+					list.hold.lock();
+				}
+				list.sequence.store(list.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+			}
+			~write_guard() {
+				list.sequence.store(list.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+				list.hold.unlock();
+			}
+			write_guard(const write_guard&) = delete;
+			write_guard& operator=(const write_guard&) = delete;
+	};
+
+	/* true if no write started since the reader saw version */
+	bool unchanged(unsigned long version) const {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return sequence.load(std::memory_order_relaxed) == version;
+	}
+
+	/* run read(version) until it completes without a concurrent write.
+	 * read may return false when it notices a write on its way. */
+	template<typename Read>
+	void read_optimistic(Read read) {
+		stat_slot& s = stats[seqlock_stat_slot()];
+		s.reads.fetch_add(1, std::memory_order_relaxed);
+		for(;;) {
+			unsigned long version = sequence.load(std::memory_order_acquire);
+			if((version & 1) == 0 && read(version) && unchanged(version)) {
+				return;
+			}
+			s.retries.fetch_add(1, std::memory_order_relaxed);
+			if(version & 1) {
+				/* the writer may be waiting for our CPU */
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	/* reader side: advance current to the first node >= v, false if a
+	 * periodic check saw a write */
+	bool skip_below(node<T>*& current, const T& v, std::size_t& steps, unsigned long version) const {
+		while(current != nullptr && current->value.load(std::memory_order_relaxed) < v) {
+			current = current->next.load(std::memory_order_acquire);
+			if(++steps % SEQLOCK_CHECK_INTERVAL == 0 && !unchanged(version)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/* writer side: first link whose node is >= v */
+	std::atomic<node<T>*>* find_link(std::atomic<node<T>*>* link, const T& v) {
+		node<T>* current = link->load(std::memory_order_relaxed);
+		while(current != nullptr && current->value.load(std::memory_order_relaxed) < v) {
+			link = &current->next;
+			current = link->load(std::memory_order_relaxed);
+		}
+		return link;
+	}
+
+	/* link a node with value v at link, returns the new node's link */
+	std::atomic<node<T>*>* link_new(std::atomic<node<T>*>* link, const T& v) {
+		node<T>* fresh = free_nodes;
+		if(fresh != nullptr) {
+			free_nodes = fresh->next.load(std::memory_order_relaxed);
+		} else {
+			fresh = new node<T>();
+		}
+		fresh->value.store(v, std::memory_order_relaxed);
+		fresh->next.store(link->load(std::memory_order_relaxed), std::memory_order_release);
+		/* readers may see the node before the write ends */
+		link->store(fresh, std::memory_order_release);
+		return &fresh->next;
+	}
+
+	/* unlink the node at link onto the free list */
+	void unlink(std::atomic<node<T>*>* link) {
+		node<T>* current = link->load(std::memory_order_relaxed);
+		/* pointer stores are releases so that any link a reader follows
+		 * orders it after the initialization of the node it points to */
+		link->store(current->next.load(std::memory_order_relaxed), std::memory_order_release);
+		current->next.store(free_nodes, std::memory_order_release);
+		free_nodes = current;
+	}
+
+	/* visit the values with lo <= value < hi of one consistent state */
+	template<typename Reset, typename Visit>
+	void scan_range(T lo, T hi, Reset reset, Visit visit) {
+		read_optimistic([&](unsigned long version) {
+			reset();
+			std::size_t steps = 0;
+			node<T>* current = first.load(std::memory_order_acquire);
+			if(!skip_below(current, lo, steps, version)) {
+				return false;
+			}
+			while(current != nullptr) {
+				T value = current->value.load(std::memory_order_relaxed);
+				if(!(value < hi)) {
+					break;
+				}
+				visit(value);
+				current = current->next.load(std::memory_order_acquire);
+				if(++steps % SEQLOCK_CHECK_INTERVAL == 0 && !unchanged(version)) {
+					return false;
+				}
+			}
+			return true;
+		});
+	}
+
+	public:
+		sorted_list() : first(nullptr), sequence(0) {
+			reset_statistics();
+		}
+		sorted_list(const sorted_list<T>& other) = delete;
+		sorted_list<T>& operator=(const sorted_list<T>& other) = delete;
+		~sorted_list() {
+			for(node<T>* list : {first.load(), free_nodes}) {
+				while(list != nullptr) {
+					node<T>* next = list->next.load();
+					delete list;
+					list = next;
+				}
+			}
+		}
+
+		/* insert v into the list */
+		void insert(T v) {
+			write_guard guard(*this);
+			link_new(find_link(&first, v), v);
+		}
+
+		void remove(T v) {
+			write_guard guard(*this);
+			std::atomic<node<T>*>* link = find_link(&first, v);
+			node<T>* current = link->load(std::memory_order_relaxed);
+			if(current == nullptr || current->value.load(std::memory_order_relaxed) != v) {
+				/* v not found */
+				return;
+			}
+			unlink(link);
+		}
+
+		/* count elements with value v in the list */
+		std::size_t count(T v) {
+			std::size_t cnt = 0;
+			read_optimistic([&](unsigned long version) {
+				cnt = 0;
+				std::size_t steps = 0;
+				node<T>* current = first.load(std::memory_order_acquire);
+				if(!skip_below(current, v, steps, version)) {
+					return false;
+				}
+				while(current != nullptr && current->value.load(std::memory_order_relaxed) == v) {
+					cnt++;
+					current = current->next.load(std::memory_order_acquire);
+					if(++steps % SEQLOCK_CHECK_INTERVAL == 0 && !unchanged(version)) {
+						return false;
+					}
+				}
+				return true;
+			});
+			return cnt;
+		}
+
+		/* insert all values of a batch in a single pass over the list */
+		void insert_batch(std::vector<T> values) {
+			std::sort(values.begin(), values.end());
+			write_guard guard(*this);
+			std::atomic<node<T>*>* link = &first;
+			for(const T& v : values) {
+				/* the next value is not smaller, so continue after the new node */
+				link = link_new(find_link(link, v), v);
+			}
+		}
+
+		/* remove one copy of every value of a batch in a single pass */
+		void remove_batch(std::vector<T> values) {
+			std::sort(values.begin(), values.end());
+			write_guard guard(*this);
+			std::atomic<node<T>*>* link = &first;
+			for(const T& v : values) {
+				link = find_link(link, v);
+				node<T>* current = link->load(std::memory_order_relaxed);
+				if(current != nullptr && current->value.load(std::memory_order_relaxed) == v) {
+					unlink(link);
+				}
+			}
+		}
+
+		/* count elements for every value of a batch in a single pass,
+		 * counts are returned in the order of values */
+		std::vector<std::size_t> count_batch(const std::vector<T>& values) {
+			std::vector<std::size_t> order(values.size());
+			for(std::size_t i = 0; i < order.size(); i++) {
+				order[i] = i;
+			}
+			std::sort(order.begin(), order.end(), [&values](std::size_t a, std::size_t b) {
+				return values[a] < values[b];
+			});
+			std::vector<std::size_t> counts(values.size());
+			read_optimistic([&](unsigned long version) {
+				std::size_t steps = 0;
+				node<T>* current = first.load(std::memory_order_acquire);
+				for(std::size_t k = 0; k < order.size(); k++) {
+					const T& v = values[order[k]];
+					if(!skip_below(current, v, steps, version)) {
+						return false;
+					}
+					std::size_t cnt = 0;
+					while(current != nullptr && current->value.load(std::memory_order_relaxed) == v) {
+						cnt++;
+						current = current->next.load(std::memory_order_acquire);
+						if(++steps % SEQLOCK_CHECK_INTERVAL == 0 && !unchanged(version)) {
+							return false;
+						}
+					}
+					if(k > 0 && values[order[k - 1]] == v) {
+						/* the run was counted for the previous key */
+						cnt = counts[order[k - 1]];
+					}
+					counts[order[k]] = cnt;
+				}
+				return true;
+			});
+			return counts;
+		}
+
+		/* count elements with lo <= value < hi */
+		std::size_t count_range(T lo, T hi) {
+			std::size_t cnt = 0;
+			scan_range(lo, hi, [&cnt]() { cnt = 0; }, [&cnt](const T&) { cnt++; });
+			return cnt;
+		}
+
+		/* copy of the elements with lo <= value < hi, in ascending order */
+		std::vector<T> snapshot(T lo, T hi) {
+			std::vector<T> values;
+			scan_range(lo, hi, [&values]() { values.clear(); }, [&values](const T& v) { values.push_back(v); });
+			return values;
+		}
+
+		/* print reads, retries and writes since the last report */
+		void report_statistics(std::ostream& out) {
+			unsigned long reads = 0, retries = 0, writes = 0, contended = 0;
+			for(auto& s : stats) {
+				reads += s.reads.load();
+				retries += s.retries.load();
+				writes += s.writes.load();
+				contended += s.contended.load();
+			}
+			out << u8"  seqlock: " << reads << u8" reads, " << (reads ? 100.0 * retries / reads : 0.0)
+			    << u8" retries per 100 reads, " << writes << u8" writes, "
+			    << (writes ? 100.0 * contended / writes : 0.0) << u8"% of writes contended\n";
+			reset_statistics();
+		}
+
+		void reset_statistics() {
+			for(auto& s : stats) {
+				s.reads = 0;
+				s.retries = 0;
+				s.writes = 0;
+				s.contended = 0;
+			}
+		}
+};
+
+#endif // lacpp_sorted_list_hpp
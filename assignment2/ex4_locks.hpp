@@ -2,7 +2,11 @@
 #define LOCKS_HPP
 
 #include <atomic>
+#include <chrono>
+#include <ostream>
+#include <string>
 #include <thread>
+#include <vector>
 #include <mutex>
 
 // https://medium.com/developer-rants/c-threads-and-atomic-variables-oversimplified-b37bbbe3f2e6
@@ -27,14 +31,26 @@ private:
     std::atomic<bool> flag = ATOMIC_VAR_INIT(false);
 public:
     void lock() {
+        lock_counting_spins();
+    }
+
+    // lock() that returns the number of spin iterations it waited
+    unsigned long lock_counting_spins() {
+        unsigned long spins = 0;
         while (true) {
             while (flag.load(std::memory_order_relaxed)) {
                 // Spin-wait
+                spins++;
             }
             if (!flag.exchange(true, std::memory_order_acquire)) {
                 break; // Lock acquired
             }
         }
+        return spins;
+    }
+
+    bool try_lock() {
+        return !flag.load(std::memory_order_relaxed) && !flag.exchange(true, std::memory_order_acquire);
     }
 
     void unlock() {
@@ -74,4 +90,184 @@ public:
     }
 };
 
+// Lock instrumentation
+
+// log2 buckets of nanoseconds, the last one also takes everything longer
+static const int LOCK_HISTOGRAM_BUCKETS = 32;
+
+struct lock_stats {
+    unsigned long acquisitions = 0;
+    unsigned long contended = 0;      // acquisitions that had to wait
+    unsigned long spins = 0;          // only counted for spinning locks
+    unsigned long wait_ns[LOCK_HISTOGRAM_BUCKETS] = {};  // contended only
+    unsigned long hold_ns[LOCK_HISTOGRAM_BUCKETS] = {};  // sampled
+
+    static int bucket(std::chrono::steady_clock::duration d) {
+        long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        int b = 0;
+        while (ns > 1 && b < LOCK_HISTOGRAM_BUCKETS - 1) {
+            ns >>= 1;
+            b++;
+        }
+        return b;
+    }
+
+    void merge(const lock_stats& other) {
+        acquisitions += other.acquisitions;
+        contended += other.contended;
+        spins += other.spins;
+        for (int b = 0; b < LOCK_HISTOGRAM_BUCKETS; b++) {
+            wait_ns[b] += other.wait_ns[b];
+            hold_ns[b] += other.hold_ns[b];
+        }
+    }
+
+    // upper bound in ns of the bucket holding quantile q, bucket b holds
+    // [2^b, 2^(b+1)) except bucket 0, which also holds 0 ns, and the last
+    // bucket, whose bound is nominal
+    static unsigned long long quantile(const unsigned long* histogram, double q) {
+        unsigned long total = 0;
+        for (int b = 0; b < LOCK_HISTOGRAM_BUCKETS; b++) {
+            total += histogram[b];
+        }
+        unsigned long seen = 0;
+        for (int b = 0; b < LOCK_HISTOGRAM_BUCKETS; b++) {
+            seen += histogram[b];
+            if (total > 0 && seen >= q * total) {
+                return (2ULL << b) - 1;
+            }
+        }
+        return 0;
+    }
+
+    static void report_histogram(std::ostream& out, const char* name, const unsigned long* histogram) {
+        out << "    " << name << " ns  p50 <= " << quantile(histogram, 0.5)
+            << ", p99 <= " << quantile(histogram, 0.99)
+            << ", max <= " << quantile(histogram, 1.0) << "\n";
+    }
+
+    void report(std::ostream& out, const std::string& name) const {
+        out << "  " << name << ": " << acquisitions << " acquisitions, "
+            << (acquisitions ? 100.0 * contended / acquisitions : 0.0) << "% contended, "
+            << (contended ? double(spins) / contended : 0.0) << " spins per contended acquisition\n";
+        if (contended) {
+            report_histogram(out, "contended wait", wait_ns);
+        }
+        if (acquisitions) {
+            report_histogram(out, "hold", hold_ns);
+        }
+    }
+};
+
+// spin counting for locks that offer it, plain lock() otherwise
+template<typename L>
+auto acquire_counting_spins(L& l, int) -> decltype(l.lock_counting_spins()) {
+    return l.lock_counting_spins();
+}
+
+template<typename L>
+unsigned long acquire_counting_spins(L& l, long) {
+    l.lock();
+    return 0;
+}
+
+// Wraps a lock with lock/try_lock/unlock (std::mutex, TATASLock) and
+// records its acquisitions, contention, spins, wait and hold times.
+// Reading the clock costs more than an uncontended acquisition, so only
+// waits of contended acquisitions are timed and the wait histogram only
+// holds those, hold times are sampled every LOCK_HOLD_SAMPLE acquisitions.
+// The statistics are only written while the lock is held, so they need
+// no synchronization of their own; read them when the lock is idle.
+// CLHLock hands out a node per acquisition and cannot be wrapped.
+static const unsigned long LOCK_HOLD_SAMPLE = 16;
+
+template<typename L>
+class instrumented_lock {
+private:
+    typedef std::chrono::steady_clock clock;
+    L inner;
+    lock_stats counters;
+    bool timed = false;            // this hold is sampled
+    clock::time_point acquired_at;
+
+    void acquired() {
+        timed = counters.acquisitions++ % LOCK_HOLD_SAMPLE == 0;
+        if (timed) {
+            acquired_at = clock::now();
+        }
+    }
+public:
+    void lock() {
+        if (!inner.try_lock()) {
+            clock::time_point start = clock::now();
+            unsigned long spins = acquire_counting_spins(inner, 0);
+            counters.contended++;
+            counters.spins += spins;
+            counters.wait_ns[lock_stats::bucket(clock::now() - start)]++;
+        }
+        acquired();
+    }
+
+    bool try_lock() {
+        if (!inner.try_lock()) {
+            return false;
+        }
+        acquired();
+        return true;
+    }
+
+    void unlock() {
+        if (timed) {
+            counters.hold_ns[lock_stats::bucket(clock::now() - acquired_at)]++;
+        }
+        inner.unlock();
+    }
+
+    const lock_stats& stats() const {
+        return counters;
+    }
+
+    void reset_stats() {
+        counters = lock_stats();
+    }
+};
+
+// print the statistics of the node locks of a list starting at head,
+// merged over the nodes at depths 0, 1-2, 3-6 and so on, and reset them.
+// Depth is where a node is now, locks of removed nodes are not included.
+// Only call this while no other thread uses the list.
+template<typename Node>
+void report_lock_bands(std::ostream& out, Node* head) {
+    std::vector<lock_stats> bands;
+    std::size_t depth = 0;
+    for (Node* n = head; n != nullptr; n = n->next, depth++) {
+        std::size_t band = 0;
+        while ((depth + 1) >> (band + 1)) {
+            band++;
+        }
+        if (bands.size() <= band) {
+            bands.resize(band + 1);
+        }
+        bands[band].merge(n->hold.stats());
+        n->hold.reset_stats();
+    }
+    for (std::size_t band = 0; band < bands.size(); band++) {
+        std::size_t lo = (std::size_t(1) << band) - 1;
+        std::size_t hi = (std::size_t(2) << band) - 2;
+        bands[band].report(out, "node locks at depth " + std::to_string(lo) + (lo == hi ? "" : "-" + std::to_string(hi)));
+    }
+}
+
+// the lists use LIST_LOCK(L) for their locks, -DINSTRUMENT_LOCKS
+// instruments them and adds report_statistics to the lists.
+// Every instrumented lock carries a full lock_stats of about 540 bytes,
+// so a node of the fine grained lists grows from 24 (TATASLock) or 56
+// (std::mutex) bytes to about 600 and a traversal touches ten times the
+// cache lines; compare instrumented runs with each other only.
+#ifdef INSTRUMENT_LOCKS
+#define LIST_LOCK(L) instrumented_lock<L>
+#else
+#define LIST_LOCK(L) L
+#endif
+
 #endif // LOCKS_HPP
@@ -0,0 +1,203 @@
+#ifndef lacpp_integration_hpp
+#define lacpp_integration_hpp lacpp_integration_hpp
+
+/* parallel numerical integration engine
+ *
+ * The integrand is a template parameter so that it is inlined into the
+ * quadrature loops. Rules integrate a single panel [a, b]; the engine
+ * either splits [a, b] into a fixed number of panels or subdivides it
+ * adaptively until a target accuracy is reached.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "reduction.hpp"
+#include "thread_pool.hpp"
+
+namespace integration {
+
+/* trapezoid rule, exact for polynomials of degree 1 */
+struct trapezoid {
+    static const int order = 2;
+    template<typename Function>
+    static long double apply(Function& f, long double a, long double b) {
+        return (b - a) * (f(a) + f(b)) / 2.0L;
+    }
+};
+
+/* Simpson's rule, exact for polynomials of degree 3 */
+struct simpson {
+    static const int order = 4;
+    template<typename Function>
+    static long double apply(Function& f, long double a, long double b) {
+        long double m = (a + b) / 2.0L;
+        return (b - a) * (f(a) + 4.0L * f(m) + f(b)) / 6.0L;
+    }
+};
+
+/* 5-point Gauss-Legendre rule, exact for polynomials of degree 9 */
+struct gauss_legendre {
+    static const int order = 10;
+    template<typename Function>
+    static long double apply(Function& f, long double a, long double b) {
+        static const long double nodes[3] = {
+            0.0L,
+            0.5384693101056830910363144207002088L,
+            0.9061798459386639927976268782993930L
+        };
+        static const long double weights[3] = {
+            0.5688888888888888888888888888888889L,
+            0.4786286704993664680412915148356382L,
+            0.2369268850561890875142640407199173L
+        };
+        long double half = (b - a) / 2.0L;
+        long double mid = (a + b) / 2.0L;
+        long double sum = weights[0] * f(mid);
+        for (int i = 1; i < 3; i++) {
+            sum += weights[i] * (f(mid - half * nodes[i]) + f(mid + half * nodes[i]));
+        }
+        return half * sum;
+    }
+};
+
+/* integrate f over [a, b] using `panels` equally sized panels */
+template<typename Rule, typename Function>
+long double integrate(Function f, long double a, long double b, long long panels, thread_pool& pool) {
+    long double h = (b - a) / panels;
+    return pool.parallel_reduce<long double>(0, panels, 0, [&](long long first, long long last) {
+        long double local_sum = 0.0L;
+        for (long long i = first; i < last; i++) {
+            /* compute panel ends from the index so errors do not accumulate */
+            long double left = a + i * h;
+            long double right = (i + 1 == panels) ? b : a + (i + 1) * h;
+            local_sum += Rule::apply(f, left, right);
+        }
+        return local_sum;
+    });
+}
+
+/* counters filled in by integrate_adaptive */
+struct adaptive_stats {
+    long long intervals = 0;   // panels evaluated (each costs three rule applications)
+    long long accepted = 0;    // panels whose error estimate met the tolerance
+    long long unconverged = 0; // panels accepted only because max_depth was reached
+    int depth = 0;             // deepest subdivision level reached
+};
+
+/* adaptive subdivision: a panel is split in half until the two halves
+ * agree with the whole within its share of the tolerance. Panels still
+ * to be examined live in a shared task queue; each worker refines its
+ * panels depth-first and hands the second half of a split to the queue
+ * whenever another worker is idle.
+ *
+ * Which panels get accepted does not depend on scheduling, so the
+ * accepted panels are summed in order of position to make the result
+ * bit-reproducible for any thread count.
+ */
+template<typename Rule, typename Function>
+long double integrate_adaptive(Function f, long double a, long double b, long double tolerance,
+                               thread_pool& pool, adaptive_stats* stats = nullptr, int max_depth = 50) {
+    struct task {
+        long double a, b, whole, tolerance;
+        int depth;
+    };
+    /* Richardson extrapolation factor for halving the panel */
+    const long double richardson = std::ldexp(1.0L, Rule::order) - 1.0L;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::vector<task> queue;
+    int busy = 0;   // workers currently refining a panel
+    std::atomic<int> idle(0); // workers waiting on an empty queue
+    std::vector<std::pair<long double, long double>> accepted; // (left end, area)
+    adaptive_stats totals;
+
+    queue.push_back(task{a, b, Rule::apply(f, a, b), tolerance, 0});
+
+    pool.run([&](int) {
+        std::vector<task> local;
+        std::vector<std::pair<long double, long double>> local_accepted;
+        adaptive_stats local_stats;
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        while (true) {
+            idle++;
+            queue_cv.wait(lock, [&]() { return !queue.empty() || busy == 0; });
+            idle--;
+            if (queue.empty()) {
+                break; /* no queued panels and nobody can produce more */
+            }
+            local.push_back(queue.back());
+            queue.pop_back();
+            busy++;
+            lock.unlock();
+
+            while (!local.empty()) {
+                task t = local.back();
+                local.pop_back();
+                long double m = (t.a + t.b) / 2.0L;
+                long double left = Rule::apply(f, t.a, m);
+                long double right = Rule::apply(f, m, t.b);
+                long double difference = left + right - t.whole;
+                local_stats.intervals++;
+                local_stats.depth = std::max(local_stats.depth, t.depth);
+                if (std::fabs(difference) <= richardson * t.tolerance || t.depth >= max_depth) {
+                    local_accepted.push_back(std::make_pair(t.a, left + right + difference / richardson));
+                    local_stats.accepted++;
+                    if (t.depth >= max_depth) {
+                        local_stats.unconverged++;
+                    }
+                    continue;
+                }
+                task first{t.a, m, left, t.tolerance / 2.0L, t.depth + 1};
+                task second{m, t.b, right, t.tolerance / 2.0L, t.depth + 1};
+                local.push_back(first);
+                /* only take the queue lock when some worker is waiting for work */
+                bool share = false;
+                if (idle.load(std::memory_order_relaxed) > 0) {
+                    std::lock_guard<std::mutex> guard(queue_mutex);
+                    if (idle > 0 && queue.empty()) {
+                        queue.push_back(second);
+                        share = true;
+                    }
+                }
+                if (share) {
+                    queue_cv.notify_one();
+                } else {
+                    local.push_back(second);
+                }
+            }
+
+            lock.lock();
+            busy--;
+            if (busy == 0 && queue.empty()) {
+                queue_cv.notify_all();
+            }
+        }
+        accepted.insert(accepted.end(), local_accepted.begin(), local_accepted.end());
+        totals.intervals += local_stats.intervals;
+        totals.accepted += local_stats.accepted;
+        totals.unconverged += local_stats.unconverged;
+        totals.depth = std::max(totals.depth, local_stats.depth);
+    });
+    if (stats != nullptr) {
+        *stats = totals;
+    }
+
+    std::sort(accepted.begin(), accepted.end());
+    std::vector<long double> areas;
+    areas.reserve(accepted.size());
+    for (auto& panel : accepted) {
+        areas.push_back(panel.second);
+    }
+    return tree_sum(areas.data(), areas.size());
+}
+
+} // namespace integration
+
+#endif // lacpp_integration_hpp
@@ -0,0 +1,129 @@
+#ifndef lacpp_rcu_hpp
+#define lacpp_rcu_hpp lacpp_rcu_hpp
+
+/* epoch based grace periods for read-copy-update structures
+ *
+ * A reader announces the global epoch in a slot of its own cache line when
+ * it enters a read section and clears the slot when it leaves, so readers
+ * never write to memory another thread writes. Writers unlink nodes and
+ * retire them with the epoch current at that time; a retired node may be
+ * freed once every reader in a read section announced a later epoch, as
+ * such readers started after the node was unreachable.
+ *
+ * There is one domain per process, like in the kernel, and a thread takes
+ * a reader slot on its first read section and gives it back when it ends.
+ */
+
+#include <atomic>
+#include <climits>
+#include <thread>
+
+#include "reduction.hpp"
+
+static const std::size_t RCU_MAX_READERS = 256;
+
+class rcu_domain {
+    struct reader_slot {
+        std::atomic<unsigned long> epoch; // 0 outside of read sections
+        std::atomic<bool> in_use;
+        char padding[CACHE_LINE_SIZE - sizeof(std::atomic<unsigned long>) - sizeof(std::atomic<bool>)];
+    };
+
+    char padding_before[CACHE_LINE_SIZE];
+    std::atomic<unsigned long> global_epoch;
+    char padding_after[CACHE_LINE_SIZE - sizeof(std::atomic<unsigned long>)];
+    /* static storage, so alignas is honoured */
+    alignas(CACHE_LINE_SIZE) reader_slot slots[RCU_MAX_READERS];
+
+    public:
+        rcu_domain() : global_epoch(1) {
+            for (auto& s : slots) {
+                s.epoch = 0;
+                s.in_use = false;
+            }
+        }
+        rcu_domain(const rcu_domain& other) = delete;
+        rcu_domain& operator=(const rcu_domain& other) = delete;
+
+        /* a free reader slot, waits while all are taken */
+        std::atomic<unsigned long>* claim() {
+            for (;;) {
+                for (auto& s : slots) {
+                    bool expected = false;
+                    if (!s.in_use.load(std::memory_order_relaxed)
+                        && s.in_use.compare_exchange_strong(expected, true)) {
+                        return &s.epoch;
+                    }
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        void release(std::atomic<unsigned long>* epoch) {
+            for (auto& s : slots) {
+                if (&s.epoch == epoch) {
+                    s.in_use.store(false, std::memory_order_release);
+                }
+            }
+        }
+
+        unsigned long current() const {
+            return global_epoch.load(std::memory_order_acquire);
+        }
+
+        /* start a new epoch, nodes retired before are unreachable for
+         * readers that announce it */
+        void advance() {
+            global_epoch.fetch_add(1);
+        }
+
+        /* oldest epoch announced by a reader, ULONG_MAX if none reads */
+        unsigned long oldest_reader() const {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            unsigned long oldest = ULONG_MAX;
+            for (auto& s : slots) {
+                unsigned long e = s.epoch.load(std::memory_order_acquire);
+                if (e != 0 && e < oldest) {
+                    oldest = e;
+                }
+            }
+            return oldest;
+        }
+};
+
+inline rcu_domain& rcu_global_domain() {
+    static rcu_domain domain;
+    return domain;
+}
+
+/* the calling thread's reader slot, taken on first use */
+inline std::atomic<unsigned long>& rcu_reader_slot() {
+    struct registration {
+        std::atomic<unsigned long>* epoch;
+        registration() : epoch(rcu_global_domain().claim()) {}
+        ~registration() { rcu_global_domain().release(epoch); }
+    };
+    thread_local registration reg;
+    return *reg.epoch;
+}
+
+/* read section: nodes reachable inside it are not freed before it ends.
+ * Read sections must not nest. */
+class rcu_read_guard {
+    std::atomic<unsigned long>& slot;
+
+    public:
+        rcu_read_guard() : slot(rcu_reader_slot()) {
+            slot.store(rcu_global_domain().current(), std::memory_order_relaxed);
+            /* the announcement has to be visible before the first pointer
+             * is read, pairs with the fence in oldest_reader */
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        rcu_read_guard(const rcu_read_guard& other) = delete;
+        rcu_read_guard& operator=(const rcu_read_guard& other) = delete;
+        ~rcu_read_guard() {
+            slot.store(0, std::memory_order_release);
+        }
+};
+
+#endif // lacpp_rcu_hpp
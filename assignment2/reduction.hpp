@@ -0,0 +1,104 @@
+#ifndef lacpp_reduction_hpp
+#define lacpp_reduction_hpp lacpp_reduction_hpp
+
+/* lock-free, reproducible reductions
+ *
+ * Each thread writes its partial result into its own slot; slots are
+ * padded to a cache line so that neighbouring threads do not invalidate
+ * each other's lines. After the threads are joined the slots are combined
+ * in a fixed pairwise tree over the slot index, so the rounding of the
+ * result only depends on the number of slots and never on which thread
+ * finished first.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+static const std::size_t CACHE_LINE_SIZE = 64;
+
+/* combine values[0..n) pairwise, (v0 + v1) + (v2 + v3) and so on */
+template<typename T, typename Op>
+T tree_reduce(const T* values, std::size_t n, T identity, Op op) {
+    if (n == 0) {
+        return identity;
+    }
+    if (n == 1) {
+        return values[0];
+    }
+    std::size_t half = n / 2;
+    return op(tree_reduce(values, half, identity, op), tree_reduce(values + half, n - half, identity, op));
+}
+
+template<typename T>
+T tree_sum(const T* values, std::size_t n) {
+    return tree_reduce(values, n, T(), [](const T& x, const T& y) { return x + y; });
+}
+
+/* one cache line aligned slot per thread */
+template<typename T>
+class padded_slots {
+    struct slot {
+        T value;
+        char padding[CACHE_LINE_SIZE - sizeof(T) % CACHE_LINE_SIZE];
+    };
+
+    std::size_t count;
+    unsigned char* storage;
+    slot* slots;
+
+    public:
+        explicit padded_slots(std::size_t n, T initial = T()) : count(n) {
+            /* over-allocate by one line and align by hand, operator new only
+             * guarantees alignment for fundamental types before C++17 */
+            storage = new unsigned char[(n + 1) * sizeof(slot)];
+            std::uintptr_t address = reinterpret_cast<std::uintptr_t>(storage);
+            address = (address + CACHE_LINE_SIZE - 1) & ~(std::uintptr_t)(CACHE_LINE_SIZE - 1);
+            slots = reinterpret_cast<slot*>(address);
+            for (std::size_t i = 0; i < count; i++) {
+                new (&slots[i].value) T(initial);
+            }
+        }
+        padded_slots(const padded_slots<T>& other) = delete;
+        padded_slots<T>& operator=(const padded_slots<T>& other) = delete;
+        ~padded_slots() {
+            for (std::size_t i = 0; i < count; i++) {
+                slots[i].value.~T();
+            }
+            delete[] storage;
+        }
+
+        T& operator[](std::size_t i) {
+            return slots[i].value;
+        }
+        const T& operator[](std::size_t i) const {
+            return slots[i].value;
+        }
+        std::size_t size() const {
+            return count;
+        }
+
+        /* same tree shape as tree_reduce, so results match for equal n */
+        template<typename Op>
+        T reduce(T identity, Op op) const {
+            return reduce(0, count, identity, op);
+        }
+        T sum() const {
+            return reduce(T(), [](const T& x, const T& y) { return x + y; });
+        }
+
+    private:
+        template<typename Op>
+        T reduce(std::size_t first, std::size_t n, T identity, Op op) const {
+            if (n == 0) {
+                return identity;
+            }
+            if (n == 1) {
+                return slots[first].value;
+            }
+            std::size_t half = n / 2;
+            return op(reduce(first, half, identity, op), reduce(first + half, n - half, identity, op));
+        }
+};
+
+#endif // lacpp_reduction_hpp
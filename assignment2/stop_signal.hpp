@@ -0,0 +1,65 @@
+#ifndef lacpp_stop_signal_hpp
+#define lacpp_stop_signal_hpp lacpp_stop_signal_hpp
+
+/* stop signal for benchmark loops
+ *
+ * Workers that check a shared flag on every operation put a load of that
+ * flag, and of whatever else lives on its cache line, on their hot path.
+ * Here the flag is a generation counter on a cache line of its own, and
+ * a worker only looks at it through a token that reads it once every
+ * `interval` operations, so a stop is noticed at most interval - 1
+ * operations late.
+ */
+
+#include <atomic>
+#include <cstddef>
+
+/* cache line size the generation counter is padded to, defined here so
+ * the header can be used on its own */
+static const std::size_t STOP_SIGNAL_CACHE_LINE = 64;
+
+class stop_signal {
+    char padding_before[STOP_SIGNAL_CACHE_LINE];
+    std::atomic<unsigned long> generation; // incremented by every request_stop
+    char padding_after[STOP_SIGNAL_CACHE_LINE - sizeof(std::atomic<unsigned long>)];
+
+    public:
+        class token {
+            const stop_signal* signal;
+            unsigned long start;
+            unsigned interval;
+            unsigned countdown;
+
+            public:
+                token(const stop_signal& s, unsigned interval)
+                    : signal(&s), start(s.current()), interval(interval ? interval : 1), countdown(this->interval) {}
+
+                /* true once a stop was requested after the token was made */
+                bool stop_requested() {
+                    if (--countdown != 0) {
+                        return false;
+                    }
+                    countdown = interval;
+                    return signal->current() != start;
+                }
+        };
+
+        stop_signal() : generation(0) {}
+        stop_signal(const stop_signal& other) = delete;
+        stop_signal& operator=(const stop_signal& other) = delete;
+
+        void request_stop() {
+            generation.fetch_add(1, std::memory_order_release);
+        }
+
+        unsigned long current() const {
+            return generation.load(std::memory_order_acquire);
+        }
+
+        /* tokens have to be made before the stop they should observe */
+        token get_token(unsigned interval = 64) const {
+            return token(*this, interval);
+        }
+};
+
+#endif // lacpp_stop_signal_hpp
@@ -0,0 +1,161 @@
+#ifndef lacpp_thread_pool_hpp
+#define lacpp_thread_pool_hpp lacpp_thread_pool_hpp
+
+/* persistent thread pool
+ *
+ * Workers are started once and then sleep on a condition variable until
+ * the next job is published, so repeated parallel loops only pay for a
+ * wake-up instead of a pthread_create/pthread_join per thread.
+ * Jobs are run one at a time; the calling thread blocks until every
+ * worker has finished the current job.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "reduction.hpp"
+
+/* dynamic parallel_reduce keeps one result per chunk, chunks are enlarged
+ * so that there are never more than this many */
+static const long long POOL_MAX_CHUNKS = 1LL << 20;
+
+class thread_pool {
+    std::vector<std::thread> workers;
+    std::mutex job_mutex;
+    std::condition_variable job_cv;
+    std::condition_variable done_cv;
+    std::function<void(int)> job;
+    unsigned long generation = 0; // incremented for every published job
+    int remaining = 0;            // workers still running the current job
+    bool stopping = false;
+
+    void worker_loop(int id) {
+        unsigned long seen = 0;
+        std::unique_lock<std::mutex> lock(job_mutex);
+        while (true) {
+            job_cv.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            lock.unlock();
+            job(id);
+            lock.lock();
+            if (--remaining == 0) {
+                done_cv.notify_one();
+            }
+        }
+    }
+
+    public:
+        explicit thread_pool(int threads) {
+            for (int i = 0; i < threads; i++) {
+                workers.emplace_back([this, i]() { worker_loop(i); });
+            }
+        }
+        thread_pool(const thread_pool& other) = delete;
+        thread_pool& operator=(const thread_pool& other) = delete;
+        ~thread_pool() {
+            {
+                std::lock_guard<std::mutex> lock(job_mutex);
+                stopping = true;
+            }
+            job_cv.notify_all();
+            for (auto& w : workers) {
+                w.join();
+            }
+        }
+
+        int size() const {
+            return (int)workers.size();
+        }
+
+        /* run fun(worker) once on every worker and wait for all of them */
+        void run(std::function<void(int)> fun) {
+            std::unique_lock<std::mutex> lock(job_mutex);
+            job = std::move(fun);
+            remaining = size();
+            generation++;
+            job_cv.notify_all();
+            done_cv.wait(lock, [&]() { return remaining == 0; });
+            job = nullptr;
+        }
+
+        /* call fun(first, last, worker) on subranges covering [begin, end).
+         * chunk == 0: one contiguous block per worker (static schedule),
+         * otherwise workers take `chunk` sized blocks from a shared counter.
+         */
+        template<typename Function>
+        void parallel_for(long long begin, long long end, long long chunk, Function fun) {
+            if (end <= begin) {
+                return;
+            }
+            long long n = end - begin;
+            if (chunk == 0) {
+                int threads = size();
+                run([&](int worker) {
+                    long long first = begin + n * worker / threads;
+                    long long last = begin + n * (worker + 1) / threads;
+                    if (first < last) {
+                        fun(first, last, worker);
+                    }
+                });
+                return;
+            }
+            std::atomic<long long> next(begin);
+            run([&](int worker) {
+                while (true) {
+                    long long first = next.fetch_add(chunk, std::memory_order_relaxed);
+                    if (first >= end) {
+                        break;
+                    }
+                    fun(first, std::min(first + chunk, end), worker);
+                }
+            });
+        }
+
+        /* chunk size parallel_reduce uses for n elements: at least chunk,
+         * and large enough for at most POOL_MAX_CHUNKS chunks */
+        static long long reduce_chunk(long long n, long long chunk) {
+            return std::max(chunk, (n + POOL_MAX_CHUNKS - 1) / POOL_MAX_CHUNKS);
+        }
+
+        /* combine map(first, last) over [begin, end) with op.
+         * Results are kept per block (static) or per chunk (dynamic) and
+         * tree-reduced in index order, so the rounding does not depend on
+         * which worker ran which block. The dynamic chunk size is raised
+         * to reduce_chunk(end - begin, chunk) to bound the memory.
+         */
+        template<typename T, typename Map, typename Op>
+        T parallel_reduce(long long begin, long long end, long long chunk, T identity, Map map, Op op) {
+            if (end <= begin) {
+                return identity;
+            }
+            long long n = end - begin;
+            if (chunk == 0) {
+                padded_slots<T> partials(size(), identity);
+                parallel_for(begin, end, 0, [&](long long first, long long last, int worker) {
+                    partials[worker] = map(first, last);
+                });
+                return partials.reduce(identity, op);
+            }
+            chunk = reduce_chunk(n, chunk);
+            std::vector<T> partials((n + chunk - 1) / chunk, identity);
+            parallel_for(begin, end, chunk, [&](long long first, long long last, int) {
+                partials[(first - begin) / chunk] = map(first, last);
+            });
+            return tree_reduce(partials.data(), partials.size(), identity, op);
+        }
+
+        template<typename T, typename Map>
+        T parallel_reduce(long long begin, long long end, long long chunk, Map map) {
+            return parallel_reduce(begin, end, chunk, T(), map, [](const T& x, const T& y) { return x + y; });
+        }
+};
+
+#endif // lacpp_thread_pool_hpp